@@ -1,6 +1,6 @@
 
 #include "pch.h"
-#ifdef _WIN32
+#if defined(_WIN32) && !defined(DU_FUNCTIONS_STATIC)
 #define DLLEXPORT __declspec(dllexport)
 #else
 #define DLLEXPORT
@@ -11,7 +11,16 @@ extern "C"
 {
 	DLLEXPORT int DuDisplay(const char*, ...);
 	DLLEXPORT int DuDisplayNumber(int32_t);
+	DLLEXPORT int DuDisplayFloat(double);
+	DLLEXPORT void DuPrintText(const char*, uint64_t);
+	DLLEXPORT void DuPrintNumber(int64_t);
+	DLLEXPORT void DuPrintUnsigned(uint64_t);
+	DLLEXPORT void DuPrintFloat(double);
 	DLLEXPORT uint8_t* DuAllocate(uint64_t);
+	DLLEXPORT uint8_t* DuAllocateAligned(uint64_t, uint64_t, uint64_t);
 	DLLEXPORT uint8_t* DuReallocate(uint64_t, uint8_t*);
 	DLLEXPORT void DuDeallocate(uint8_t*);
+	DLLEXPORT int32_t DuCpuFeatureLevel(void);
+	DLLEXPORT void DuWriteProfile(const char*, uint64_t, const uint64_t*, uint64_t);
+	DLLEXPORT void DuBoundsCheckFailed(int64_t, int64_t);
 }
\ No newline at end of file
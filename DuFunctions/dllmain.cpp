@@ -1,6 +1,7 @@
 ﻿// dllmain.cpp : Definiuje punkt wejścia dla aplikacji DLL.
 #include "pch.h"
 #include "DuFunctions.h"
+#if defined(_WIN32) && !defined(DU_FUNCTIONS_STATIC)
 BOOL APIENTRY DllMain( HMODULE hModule,
                        DWORD  ul_reason_for_call,
                        LPVOID lpReserved
@@ -16,9 +17,57 @@ BOOL APIENTRY DllMain( HMODULE hModule,
     }
     return TRUE;
 }
+#endif
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+// Every block starts with this record, right before the pointer handed out, so DuDeallocate
+// can free aligned and page-mapped blocks alike. Blocks of DU_HUGE_THRESHOLD bytes or more are
+// mapped directly and, where the OS supports it, backed by transparent huge pages. The compiler
+// emits static blocks, such as const-evaluated tables, with a null base; they are never freed.
+#define DU_HUGE_THRESHOLD (64ull << 20)
+#define DU_HUGE_PAGE (2ull << 20)
+#define DU_MIN_ALIGNMENT 16ull
+typedef struct
+{
+    uint8_t* base;
+    uint64_t size;
+    uint64_t mapped;
+    uint64_t reserved;
+} DuBlock;
+
+static uint8_t* DuMapPages(uint64_t length)
+{
+#if defined(_WIN32)
+    return (uint8_t*)VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* pages = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED)
+        return NULL;
+#if defined(MADV_HUGEPAGE)
+    madvise(pages, length, MADV_HUGEPAGE);
+#endif
+    return (uint8_t*)pages;
+#endif
+}
+
+static void DuUnmapPages(uint8_t* pages, uint64_t length)
+{
+#if defined(_WIN32)
+    (void)length;
+    VirtualFree(pages, 0, MEM_RELEASE);
+#else
+    munmap(pages, length);
+#endif
+}
 extern "C"
 {
     DLLEXPORT int DuDisplay(const char* fmt, ...)
@@ -33,17 +82,134 @@ extern "C"
     {
         return printf("\t%d\n", n);
     }
+    DLLEXPORT int DuDisplayFloat(double n)
+    {
+        return printf("\t%g\n", n);
+    }
+    // $print goes through stdout's buffer like the rest of the output, but copies its text
+    // as is: literals come with their length and numbers are converted by hand.
+    DLLEXPORT void DuPrintText(const char* text, uint64_t length)
+    {
+        fwrite(text, 1, length, stdout);
+    }
+    DLLEXPORT void DuPrintUnsigned(uint64_t n)
+    {
+        char digits[20];
+        char* first = digits + sizeof(digits);
+        do
+        {
+            *--first = (char)('0' + n % 10);
+            n /= 10;
+        } while (n);
+        fwrite(first, 1, digits + sizeof(digits) - first, stdout);
+    }
+    DLLEXPORT void DuPrintNumber(int64_t n)
+    {
+        if (n < 0)
+            fputc('-', stdout);
+        DuPrintUnsigned(n < 0 ? 0 - (uint64_t)n : (uint64_t)n);
+    }
+    DLLEXPORT void DuPrintFloat(double n)
+    {
+        printf("%g", n);
+    }
+    // Returns a block whose address plus `offset` is a multiple of `alignment`, a power of two;
+    // `offset` must be a multiple of 16. Compiled `new<N>` passes the bounds-check header as offset.
+    DLLEXPORT uint8_t* DuAllocateAligned(uint64_t size, uint64_t alignment, uint64_t offset)
+    {
+        if (alignment < DU_MIN_ALIGNMENT)
+            alignment = DU_MIN_ALIGNMENT;
+        const uint64_t extra = sizeof(DuBlock) + offset + alignment;
+        uint64_t mapped = 0;
+        uint8_t* base = NULL;
+        if (size >= DU_HUGE_THRESHOLD)
+        {
+            mapped = (size + extra + DU_HUGE_PAGE - 1) & ~(DU_HUGE_PAGE - 1);
+            base = DuMapPages(mapped);
+        }
+        else
+            base = (uint8_t*)malloc(size + extra);
+        if (!base)
+            return NULL;
+        uintptr_t user = ((uintptr_t)base + sizeof(DuBlock) + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        user -= offset;
+        DuBlock* block = (DuBlock*)user - 1;
+        block->base = base;
+        block->size = size;
+        block->mapped = mapped;
+        return (uint8_t*)user;
+    }
     DLLEXPORT uint8_t* DuAllocate(uint64_t size)
     {
-        uint8_t* ret = (uint8_t*)malloc(size);
-        return ret;
+        return DuAllocateAligned(size, DU_MIN_ALIGNMENT, 0);
+    }
+    DLLEXPORT void DuDeallocate(uint8_t* memory)
+    {
+        if (!memory)
+            return;
+        DuBlock* block = (DuBlock*)memory - 1;
+        if (!block->base)
+            return;
+        if (block->mapped)
+            DuUnmapPages(block->base, block->mapped);
+        else
+            free(block->base);
     }
     DLLEXPORT uint8_t* DuReallocate(uint64_t size, uint8_t* memory)
     {
-        return (uint8_t*)realloc((void*)memory, size);
+        if (!memory)
+            return DuAllocate(size);
+        const DuBlock* block = (const DuBlock*)memory - 1;
+        uint8_t* ret = DuAllocate(size);
+        if (ret)
+        {
+            memcpy(ret, memory, block->size < size ? block->size : size);
+            DuDeallocate(memory);
+        }
+        return ret;
     }
-    DLLEXPORT void DuDeallocate(uint8_t* memory)
+    // 0 - baseline x86-64, 1 - AVX2/FMA/BMI2, 2 - AVX-512 F/BW/DQ/VL; picks multiversioned clones at load time
+    DLLEXPORT int32_t DuCpuFeatureLevel(void)
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int leaf1[4], leaf7[4];
+        __cpuid(leaf1, 1);
+        __cpuidex(leaf7, 7, 0);
+        const bool osxsave = leaf1[2] & (1 << 27);
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        const bool avx2 = (xcr0 & 0x6) == 0x6 && (leaf1[2] & (1 << 12)) && (leaf7[1] & (1 << 5)) && (leaf7[1] & (1 << 3)) && (leaf7[1] & (1 << 8));
+        const bool avx512 = avx2 && (xcr0 & 0xE6) == 0xE6 && (leaf7[1] & (1 << 16)) && (leaf7[1] & (1 << 17)) && (leaf7[1] & (1 << 30)) && (leaf7[1] & (1u << 31));
+        return avx512 ? 2 : avx2 ? 1 : 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2");
+        const bool avx512 = avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+        return avx512 ? 2 : avx2 ? 1 : 0;
+#else
+        return 0;
+#endif
+    }
+    // Written at exit by programs built with -profile-generate; read back by -profile-use
+    DLLEXPORT void DuWriteProfile(const char* path, uint64_t hash, const uint64_t* counters, uint64_t count)
+    {
+        FILE* file = NULL;
+#if defined(_MSC_VER)
+        if (fopen_s(&file, path, "w"))
+            file = NULL;
+#else
+        file = fopen(path, "w");
+#endif
+        if (!file)
+            return;
+        fprintf(file, "du-profile %llu %llu\n", (unsigned long long)hash, (unsigned long long)count);
+        for (uint64_t i = 0; i < count; i++)
+            fprintf(file, "%llu\n", (unsigned long long)counters[i]);
+        fclose(file);
+    }
+    // Called by -bounds-check programs when an index is outside the array `new` allocated
+    DLLEXPORT void DuBoundsCheckFailed(int64_t index, int64_t count)
     {
-        free((uint8_t*)memory);
+        fprintf(stderr, "index %lld out of bounds for array of %lld elements\n", (long long)index, (long long)count);
+        fflush(stdout);
+        abort();
     }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN             // Wyklucz rzadko używane rzeczy z nagłówków systemu Windows
 // Pliki nagłówkowe systemu Windows
 #include <windows.h>
+#endif
@@ -15,19 +15,29 @@ class AstTree
 {
 	Scope* m_root;
 	std::vector<Scope*> m_scopes;
-	std::stack<Scope*> m_stack;
+	std::stack<Scope*>& getStack()
+	{
+		// each lowering thread walks the scopes with its own stack rooted at the global scope
+		thread_local std::stack<Scope*> s_stack;
+		if (s_stack.empty())
+			s_stack.push(m_root);
+		return s_stack;
+	}
 	void createSysFunction()
 	{
-		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::DISPLAY), TypeContainer::instance().getType(Type::generateId(ObjectInByte::DWORD, true)), {}, {}, true, false));
-		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::ALLOCATE_MEMORY), TypeContainer::instance().getType(TypeContainer::generatePointerType({Type::U8})), {}, {}, true, false));
+		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::DISPLAY), TypeContainer::instance().getNumericType(ObjectInByte::DWORD, true), {}, {}, true, false));
+		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::ALLOCATE_MEMORY), TypeContainer::instance().getPointerType(TypeContainer::instance().getNumericType(ObjectInByte::BYTE, false)), {}, {}, true, false));
 		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::DEALLOCATE_MEMORY), nullptr, {}, {}, true, true));
+		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::COPY_MEMORY), nullptr, {}, {}, true, true));
+		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::FILL_MEMORY), nullptr, {}, {}, true, true));
+		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::MOVE_MEMORY), nullptr, {}, {}, true, true));
+		m_scopes.emplace_back(new Function(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::STREAM_STORE), nullptr, {}, {}, true, true));
 	}
 
 	AstTree()
 	{
 		m_root = new Scope(Identifier("GLOBAL_SCOPE"));
 		s_GlobalScope = m_root;
-		m_stack.push(m_root);
 		m_scopes.push_back(m_root);
 		createSysFunction();
 	}
@@ -45,8 +55,8 @@ public:
 				return (!_obj->isStatement() && !dynamic_cast<ISelfGeneratedScope*>(obj) && _obj->getIdentifier() == obj->getIdentifier());
 			
 			};
-		assert(!m_stack.empty());
-		Scope* top = m_stack.top();
+		assert(!getStack().empty());
+		Scope* top = getStack().top();
 		auto filteredView = std::views::filter(*top, predicate);
 		if (std::ranges::distance(filteredView) > 0)
 		{
@@ -60,7 +70,7 @@ public:
 				assert(0);
 			}
 		}
-		obj->setParent(m_stack.top());
+		obj->setParent(getStack().top());
 		top->addChild(obj);
 	}
 
@@ -77,12 +87,12 @@ public:
 			}
 			m_scopes.push_back(scope);
 		}
-		m_stack.push(scope);
+		getStack().push(scope);
 	}
 	void endScope()
 	{
-		assert(m_stack.top() != m_root);
-		m_stack.pop();
+		assert(getStack().top() != m_root);
+		getStack().pop();
 	}
 	Iterator begin()
 	{
@@ -129,7 +139,7 @@ public:
 		}
 		else
 		{
-			Scope* scope = m_stack.top();
+			Scope* scope = getStack().top();
 			while (true)
 			{
 				if (!scope)
@@ -164,7 +174,7 @@ public:
 	}
 	Scope* getCurrentScope()
 	{
-		return m_stack.top();
+		return getStack().top();
 	}
 	bool setCurrentScope(Scope* sc)
 	{
@@ -177,7 +187,7 @@ public:
 
 		if (it != m_scopes.end())
 		{
-			m_stack.push(*it);
+			getStack().push(*it);
 			return true;
 		}
 		return false;
@@ -204,7 +214,7 @@ public:
 	}
 	bool inGlobal()
 	{
-		auto top = m_stack.top();
+		auto top = getStack().top();
 		return (top == m_root);
 	}
 
@@ -0,0 +1,284 @@
+#pragma once
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/ScalarEvolutionExpander.h>
+#include "LLvmBuilder.h"
+#include <vector>
+
+// Checked arrays for -bounds-check. `new` allocates a 16 byte header in front of the elements
+// and stores the element count in its last 8 bytes, so the pointer handed to the program keeps
+// its layout and alignment. Indexing calls `du.bounds.check(index, count)`; the call stays opaque
+// through the scalar pipeline so BoundsCheckEliminationPass can drop or hoist it, and is expanded
+// to a compare and a cold trap branch at the end of the pipeline. At -O0 it stays a plain call.
+class BoundsCheck final
+{
+	static inline bool s_enabled = false;
+	static constexpr uint64_t s_headerSize = 16;
+	static constexpr const char* s_check = "du.bounds.check";
+	static constexpr const char* s_checkAttribute = "du-bounds-check";
+	static constexpr const char* s_countMetadata = "du.bounds.count";
+	static constexpr const char* s_fail = "DuBoundsCheckFailed";
+
+	static llvm::FunctionCallee getFailFunction(llvm::Module& m)
+	{
+		llvm::IRBuilder<> b(m.getContext());
+		llvm::FunctionCallee fail = m.getOrInsertFunction(s_fail, b.getVoidTy(), b.getInt64Ty(), b.getInt64Ty());
+		if (auto* fn = llvm::dyn_cast<llvm::Function>(fail.getCallee()))
+		{
+			fn->setDoesNotReturn();
+			fn->setDoesNotThrow();
+			fn->addFnAttr(llvm::Attribute::Cold);
+		}
+		return fail;
+	}
+
+	static void emitTrap(llvm::IRBuilder<>& b, llvm::Value* index, llvm::Value* count, llvm::Instruction* before)
+	{
+		llvm::Module& m = *before->getModule();
+		llvm::MDNode* cold = llvm::MDBuilder(m.getContext()).createBranchWeights(1, 1 << 20);
+		llvm::Instruction* then = llvm::SplitBlockAndInsertIfThen(b.CreateICmpUGE(index, count), before, true, cold);
+		b.SetInsertPoint(then);
+		b.CreateCall(getFailFunction(m), { index, count })->setDoesNotReturn();
+	}
+
+	static llvm::Function* getCheckFunction(llvm::Module& m)
+	{
+		if (llvm::Function* fn = m.getFunction(s_check))
+			return fn;
+		llvm::IRBuilder<> b(m.getContext());
+		llvm::FunctionType* type = llvm::FunctionType::get(b.getVoidTy(), { b.getInt64Ty(), b.getInt64Ty() }, false);
+		llvm::Function* fn = llvm::Function::Create(type, llvm::GlobalValue::InternalLinkage, s_check, m);
+		fn->addFnAttr(s_checkAttribute);
+		fn->addFnAttr(llvm::Attribute::NoInline);
+		fn->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
+		fn->setDoesNotThrow();
+		b.SetInsertPoint(llvm::BasicBlock::Create(m.getContext(), "entry", fn));
+		llvm::ReturnInst* ret = b.CreateRetVoid();
+		b.SetInsertPoint(ret);
+		emitTrap(b, fn->getArg(0), fn->getArg(1), ret);
+		return fn;
+	}
+
+	static std::vector<llvm::CallInst*> getChecks(llvm::Function& fn)
+	{
+		std::vector<llvm::CallInst*> checks;
+		for (llvm::Instruction& inst : llvm::instructions(fn))
+		{
+			auto* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+			llvm::Function* callee = call ? call->getCalledFunction() : nullptr;
+			if (callee && callee->hasFnAttribute(s_checkAttribute))
+				checks.push_back(call);
+		}
+		return checks;
+	}
+
+public:
+	static void enable()
+	{
+		s_enabled = true;
+	}
+
+	static bool isEnabled()
+	{
+		return s_enabled;
+	}
+
+	// An over-aligned `new<N>` asks the runtime to align the elements, not the header.
+	static llvm::Value* allocate(llvm::IRBuilder<>& b, llvm::Value* sizeofElement, llvm::Value* counts, llvm::FunctionCallee* allocateFunc, uint64_t alignment = 0)
+	{
+		sizeofElement = b.CreateIntCast(sizeofElement, b.getInt64Ty(), false);
+		counts = b.CreateIntCast(counts, b.getInt64Ty(), false);
+		llvm::Value* size = b.CreateAdd(b.CreateMul(counts, sizeofElement), b.getInt64(s_headerSize), "CalculateSizeToAllocate");
+		llvm::Value* memory = LlvmBuilder::allocateBytes(b, size, allocateFunc, alignment, s_headerSize);
+		llvm::Value* data = b.CreateConstInBoundsGEP1_64(b.getInt8Ty(), memory, s_headerSize, "checked_array");
+		llvm::Value* header = b.CreateConstInBoundsGEP1_64(b.getInt8Ty(), data, -8);
+		b.CreateStore(counts, b.CreateBitCast(header, b.getInt64Ty()->getPointerTo()));
+		return data;
+	}
+
+	// Maps a checked array back to the block `new` allocated; null stays null.
+	static llvm::Value* getAllocation(llvm::IRBuilder<>& b, llvm::Value* ptr)
+	{
+		llvm::Type* type = ptr->getType();
+		llvm::Value* bytes = b.CreateBitCast(ptr, b.getInt8PtrTy());
+		llvm::Value* memory = b.CreateConstGEP1_64(b.getInt8Ty(), bytes, -static_cast<int64_t>(s_headerSize));
+		llvm::Value* isNull = b.CreateICmpEQ(bytes, llvm::Constant::getNullValue(bytes->getType()));
+		return b.CreateBitCast(b.CreateSelect(isNull, bytes, memory), type);
+	}
+
+	// Header of a checked array the compiler lays out itself, such as a const-evaluated table
+	static llvm::Constant* getConstantHeader(llvm::LLVMContext& context, uint64_t count)
+	{
+		llvm::IntegerType* i64 = llvm::Type::getInt64Ty(context);
+		return llvm::ConstantArray::get(llvm::ArrayType::get(i64, s_headerSize / sizeof(uint64_t)), { llvm::ConstantInt::get(i64, 0), llvm::ConstantInt::get(i64, count) });
+	}
+
+	static void emitCheck(llvm::IRBuilder<>& b, llvm::Value* ptr, llvm::Value* index)
+	{
+		llvm::Value* bytes = b.CreateBitCast(ptr, b.getInt8PtrTy());
+		llvm::Value* header = b.CreateBitCast(b.CreateConstInBoundsGEP1_64(b.getInt8Ty(), bytes, -8), b.getInt64Ty()->getPointerTo());
+		llvm::LoadInst* count = b.CreateLoad(b.getInt64Ty(), header, "array_count");
+		count->setMetadata(s_countMetadata, llvm::MDNode::get(b.getContext(), {}));
+		emitExtentCheck(b, index, count);
+	}
+
+	// Checks an index against a count the program already holds, such as an arrayN extent.
+	static void emitExtentCheck(llvm::IRBuilder<>& b, llvm::Value* index, llvm::Value* count)
+	{
+		llvm::Module& m = *b.GetInsertBlock()->getModule();
+		b.CreateCall(getCheckFunction(m), { b.CreateIntCast(index, b.getInt64Ty(), true), b.CreateIntCast(count, b.getInt64Ty(), false) });
+	}
+
+	// Expands every remaining check in place and drops the out-of-line helpers.
+	static bool lower(llvm::Module& m)
+	{
+		std::vector<llvm::Function*> helpers;
+		for (llvm::Function& fn : m)
+		{
+			if (fn.hasFnAttribute(s_checkAttribute))
+				helpers.push_back(&fn);
+		}
+		if (helpers.empty())
+			return false;
+		llvm::IRBuilder<> b(m.getContext());
+		for (llvm::Function& fn : m)
+		{
+			if (fn.hasFnAttribute(s_checkAttribute))
+				continue;
+			for (llvm::CallInst* call : getChecks(fn))
+			{
+				b.SetInsertPoint(call);
+				emitTrap(b, call->getArgOperand(0), call->getArgOperand(1), call);
+				call->eraseFromParent();
+			}
+		}
+		for (llvm::Function* fn : helpers)
+		{
+			if (fn->use_empty())
+				fn->eraseFromParent();
+		}
+		return true;
+	}
+
+	static void registerPasses(llvm::PassBuilder& pb);
+	friend class BoundsCheckEliminationPass;
+};
+
+// Runs after the loop optimizations, when induction variables are canonical. A check whose index
+// SCEV is known to be below the count is dropped; a duplicate of a dominating check is dropped;
+// a check executed on every iteration of a counted loop with an increasing index is replaced by
+// one check of the last index in the preheader. A hoisted check fails before the loop instead
+// of in the iteration that would have gone out of bounds.
+class BoundsCheckEliminationPass : public llvm::PassInfoMixin<BoundsCheckEliminationPass>
+{
+	// The count lives in the header, which only `new` writes and which checked indexing can
+	// never reach, so a header load with a loop invariant address can move to the preheader.
+	static llvm::Value* getInvariantCount(llvm::Value* count, llvm::Loop* loop, llvm::Instruction* at)
+	{
+		if (loop->isLoopInvariant(count))
+			return count;
+		auto* load = llvm::dyn_cast<llvm::LoadInst>(count);
+		if (!load || !load->getMetadata(BoundsCheck::s_countMetadata) || !loop->isLoopInvariant(load->getPointerOperand()))
+			return nullptr;
+		llvm::Instruction* hoisted = load->clone();
+		hoisted->insertBefore(at);
+		return hoisted;
+	}
+
+	static bool hoist(llvm::CallInst* call, llvm::LoopInfo& li, llvm::ScalarEvolution& se, llvm::DominatorTree& dt)
+	{
+		llvm::Loop* loop = li.getLoopFor(call->getParent());
+		if (!loop)
+			return false;
+		llvm::BasicBlock* preheader = loop->getLoopPreheader();
+		llvm::BasicBlock* latch = loop->getLoopLatch();
+		if (!preheader || !latch || loop->getExitingBlock() != latch || !dt.dominates(call->getParent(), latch))
+			return false;
+		auto* index = llvm::dyn_cast<llvm::SCEVAddRecExpr>(se.getSCEV(call->getArgOperand(0)));
+		if (!index || index->getLoop() != loop || !index->isAffine() || !se.isKnownNonNegative(index->getStepRecurrence(se)))
+			return false;
+		if (!index->hasNoUnsignedWrap() && !(index->hasNoSignedWrap() && se.isKnownNonNegative(index->getStart())))
+			return false;
+		const llvm::SCEV* taken = se.getBackedgeTakenCount(loop);
+		if (llvm::isa<llvm::SCEVCouldNotCompute>(taken))
+			return false;
+		const llvm::SCEV* last = index->evaluateAtIteration(taken, se);
+		llvm::Instruction* at = preheader->getTerminator();
+		if (!llvm::isSafeToExpandAt(last, at, se))
+			return false;
+		llvm::Value* count = getInvariantCount(call->getArgOperand(1), loop, at);
+		if (!count)
+			return false;
+		llvm::SCEVExpander expander(se, call->getModule()->getDataLayout(), "bounds");
+		llvm::Value* lastIndex = expander.expandCodeFor(last, call->getArgOperand(0)->getType(), at);
+		llvm::CallInst::Create(call->getFunctionType(), call->getCalledOperand(), { lastIndex, count }, "", at);
+		call->eraseFromParent();
+		return true;
+	}
+
+public:
+	llvm::PreservedAnalyses run(llvm::Function& fn, llvm::FunctionAnalysisManager& fam)
+	{
+		std::vector<llvm::CallInst*> checks = BoundsCheck::getChecks(fn);
+		if (checks.empty())
+			return llvm::PreservedAnalyses::all();
+		auto& li = fam.getResult<llvm::LoopAnalysis>(fn);
+		auto& se = fam.getResult<llvm::ScalarEvolutionAnalysis>(fn);
+		auto& dt = fam.getResult<llvm::DominatorTreeAnalysis>(fn);
+		std::vector<llvm::CallInst*> kept;
+		bool changed = false;
+		for (llvm::CallInst* call : checks)
+		{
+			llvm::Value* index = call->getArgOperand(0);
+			llvm::Value* count = call->getArgOperand(1);
+			bool redundant = se.isKnownPredicate(llvm::ICmpInst::ICMP_ULT, se.getSCEV(index), se.getSCEV(count));
+			for (llvm::CallInst* other : kept)
+			{
+				if (!redundant && other->getArgOperand(0) == index && other->getArgOperand(1) == count && dt.dominates(other, call))
+					redundant = true;
+			}
+			if (redundant)
+			{
+				call->eraseFromParent();
+				changed = true;
+			}
+			else if (hoist(call, li, se, dt))
+				changed = true;
+			else
+				kept.push_back(call);
+		}
+		if (!changed)
+			return llvm::PreservedAnalyses::all();
+		llvm::PreservedAnalyses pa;
+		pa.preserveSet<llvm::CFGAnalyses>();
+		return pa;
+	}
+};
+
+class BoundsCheckLoweringPass : public llvm::PassInfoMixin<BoundsCheckLoweringPass>
+{
+public:
+	llvm::PreservedAnalyses run(llvm::Module& m, llvm::ModuleAnalysisManager&)
+	{
+		return BoundsCheck::lower(m) ? llvm::PreservedAnalyses::none() : llvm::PreservedAnalyses::all();
+	}
+};
+
+inline void BoundsCheck::registerPasses(llvm::PassBuilder& pb)
+{
+	pb.registerScalarOptimizerLateEPCallback([](llvm::FunctionPassManager& fpm, llvm::OptimizationLevel) {
+		fpm.addPass(BoundsCheckEliminationPass());
+	});
+	pb.registerOptimizerLastEPCallback([](llvm::ModulePassManager& mpm, llvm::OptimizationLevel) {
+		mpm.addPass(BoundsCheckLoweringPass());
+	});
+}
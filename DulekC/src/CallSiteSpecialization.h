@@ -0,0 +1,195 @@
+#pragma once
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <algorithm>
+#include <format>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MessageEngine.h"
+
+extern void Info(MessageEngine::Code code, std::string_view additionalMsg);
+
+// Clones a function for call sites passing literals, with the literals in place of the
+// parameters, so the optimizer can fold the branches they decide and unroll loops they bound.
+// `specialize fnc` functions are cloned for every literal argument; other internal functions
+// only when small and when a literal reaches a comparison, a switch, a divisor or a shift
+// amount. Clones are shared by every call with the same literals, and their instructions
+// count against one budget for the module.
+class CallSiteSpecialization final
+{
+public:
+	static constexpr const char* s_attribute = "du-specialize";
+private:
+	static constexpr uint64_t s_defaultBudget = 8192;
+	static constexpr unsigned s_maxAutomaticSize = 256;
+	static inline uint64_t s_budget = s_defaultBudget;
+
+	using Key = std::pair<llvm::Function*, std::vector<llvm::Constant*>>;
+
+	static bool isLiteral(llvm::Value* v)
+	{
+		return llvm::isa<llvm::ConstantInt>(v) || llvm::isa<llvm::ConstantFP>(v);
+	}
+
+	// Parameters are spilled to their variable's slot on entry, so the walk follows the slot's loads.
+	static bool decidesControlFlow(llvm::Argument* arg)
+	{
+		std::set<llvm::Value*> visited;
+		std::vector<llvm::Value*> worklist{ arg };
+		while (!worklist.empty())
+		{
+			llvm::Value* v = worklist.back();
+			worklist.pop_back();
+			if (!visited.insert(v).second)
+				continue;
+			for (llvm::User* user : v->users())
+			{
+				if (llvm::isa<llvm::ICmpInst>(user) || llvm::isa<llvm::FCmpInst>(user) || llvm::isa<llvm::SwitchInst>(user))
+					return true;
+				if (auto* op = llvm::dyn_cast<llvm::BinaryOperator>(user))
+				{
+					if (op->getOperand(1) == v && (op->isShift() || op->getOpcode() == llvm::Instruction::UDiv || op->getOpcode() == llvm::Instruction::SDiv
+						|| op->getOpcode() == llvm::Instruction::URem || op->getOpcode() == llvm::Instruction::SRem))
+						return true;
+					worklist.push_back(op);
+				}
+				else if (llvm::isa<llvm::CastInst>(user))
+					worklist.push_back(user);
+				else if (auto* store = llvm::dyn_cast<llvm::StoreInst>(user); store && store->getValueOperand() == v)
+				{
+					if (auto* slot = llvm::dyn_cast<llvm::AllocaInst>(store->getPointerOperand()))
+					{
+						for (llvm::User* slotUser : slot->users())
+						{
+							if (llvm::isa<llvm::LoadInst>(slotUser))
+								worklist.push_back(slotUser);
+						}
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	// Literals worth binding for this call, null for the parameters left in the clone.
+	static std::vector<llvm::Constant*> getBindings(llvm::CallInst* call, llvm::Function* callee)
+	{
+		const bool requested = callee->hasFnAttribute(s_attribute);
+		std::vector<llvm::Constant*> bindings(call->arg_size(), nullptr);
+		for (unsigned i = 0; i < call->arg_size(); i++)
+		{
+			llvm::Value* operand = call->getArgOperand(i);
+			if (isLiteral(operand) && (requested || decidesControlFlow(callee->getArg(i))))
+				bindings[i] = llvm::cast<llvm::Constant>(operand);
+		}
+		return bindings;
+	}
+
+	// Compiler helpers such as `du.bounds.check` are named `du.*`, which no Du identifier can
+	// spell; passes that lower them rely on their exact signature, so only `fnc` code is cloned.
+	static bool isCandidate(llvm::Function* callee)
+	{
+		if (!callee || callee->isDeclaration() || callee->isVarArg() || callee->hasFnAttribute("du-multiversion") || callee->getName().startswith("du."))
+			return false;
+		if (callee->hasFnAttribute(s_attribute))
+			return true;
+		return callee->hasLocalLinkage() && callee->getInstructionCount() <= s_maxAutomaticSize;
+	}
+
+	static std::string getCloneName(llvm::Function* fn, const std::vector<llvm::Constant*>& bindings)
+	{
+		std::string name = std::string(fn->getName()) + ".spec";
+		for (llvm::Constant* c : bindings)
+		{
+			if (auto* ci = llvm::dyn_cast_or_null<llvm::ConstantInt>(c))
+				name += "." + std::to_string(ci->getSExtValue());
+			else if (auto* cf = llvm::dyn_cast_or_null<llvm::ConstantFP>(c))
+				name += "." + std::to_string(cf->getValueAPF().convertToDouble());
+			else
+				name += "._";
+		}
+		return name;
+	}
+
+	static llvm::Function* createClone(llvm::Function* fn, const std::vector<llvm::Constant*>& bindings)
+	{
+		llvm::ValueToValueMapTy vmap;
+		for (unsigned i = 0; i < bindings.size(); i++)
+		{
+			if (bindings[i])
+				vmap[fn->getArg(i)] = bindings[i];
+		}
+		llvm::Function* clone = llvm::CloneFunction(fn, vmap);
+		clone->setName(getCloneName(fn, bindings));
+		clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+		clone->removeFnAttr(s_attribute);
+		return clone;
+	}
+
+	static void redirect(llvm::CallInst* call, llvm::Function* clone, const std::vector<llvm::Constant*>& bindings)
+	{
+		std::vector<llvm::Value*> args;
+		for (unsigned i = 0; i < bindings.size(); i++)
+		{
+			if (!bindings[i])
+				args.push_back(call->getArgOperand(i));
+		}
+		llvm::CallInst* specialized = llvm::CallInst::Create(clone->getFunctionType(), clone, args, "", call);
+		specialized->setCallingConv(clone->getCallingConv());
+		specialized->setDebugLoc(call->getDebugLoc());
+		specialized->takeName(call);
+		call->replaceAllUsesWith(specialized);
+		call->eraseFromParent();
+	}
+
+public:
+	// Instructions all clones may add together; 0 turns specialization off.
+	static void setBudget(uint64_t budget)
+	{
+		s_budget = budget;
+	}
+
+	static bool run(llvm::Module& m)
+	{
+		std::vector<llvm::CallInst*> calls;
+		for (llvm::Function& fn : m)
+		{
+			for (llvm::Instruction& inst : llvm::instructions(fn))
+			{
+				auto* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+				if (call && isCandidate(call->getCalledFunction()) && call->getFunctionType() == call->getCalledFunction()->getFunctionType())
+					calls.push_back(call);
+			}
+		}
+		std::map<Key, llvm::Function*> clones;
+		uint64_t used = 0;
+		bool changed = false;
+		for (llvm::CallInst* call : calls)
+		{
+			llvm::Function* callee = call->getCalledFunction();
+			std::vector<llvm::Constant*> bindings = getBindings(call, callee);
+			if (std::all_of(bindings.begin(), bindings.end(), [](llvm::Constant* c) { return !c; }))
+				continue;
+			Key key(callee, bindings);
+			auto it = clones.find(key);
+			if (it == clones.end())
+			{
+				const unsigned size = callee->getInstructionCount();
+				if (used + size > s_budget)
+					continue;
+				used += size;
+				it = clones.emplace(std::move(key), createClone(callee, bindings)).first;
+				Info(MessageEngine::Code::SPECIALIZATION, std::format("{} ({} instructions, {} of {} used)", it->second->getName().str(), size, used, s_budget));
+			}
+			redirect(call, it->second, bindings);
+			changed = true;
+		}
+		return changed;
+	}
+};
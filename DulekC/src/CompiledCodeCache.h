@@ -0,0 +1,114 @@
+#pragma once
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+// On-disk object cache shared by the JIT (as an llvm::ObjectCache) and by AOT emission.
+// Entries are keyed by the hash of the module's full bitcode together with the code generation
+// settings, so attributes, metadata (branch weights, loop hints, nontemporal stores) and the
+// profile summary all take part in the key.
+// Files are published with an atomic rename, so any number of compiler processes may share a
+// directory; the directory is pruned down to the size limit after every store.
+class CompiledCodeCache final : public llvm::ObjectCache
+{
+	std::string m_directory;
+	std::string m_settings;
+	uint64_t m_sizeLimit;
+	std::atomic<uint64_t> m_hits{ 0 };
+	std::atomic<uint64_t> m_misses{ 0 };
+
+	static constexpr const char s_prefix[] = "llvmcache-du-";
+
+	std::string getPath(const std::string& key) const
+	{
+		llvm::SmallString<128> path(m_directory);
+		llvm::sys::path::append(path, s_prefix + key);
+		return std::string(path.str());
+	}
+
+public:
+	CompiledCodeCache(const std::string& directory, const std::string& settings, uint64_t sizeLimit)
+		: m_directory(directory), m_settings(settings), m_sizeLimit(sizeLimit)
+	{
+		llvm::sys::fs::create_directories(m_directory);
+	}
+
+	std::string getKey(const llvm::Module& m) const
+	{
+		llvm::SmallVector<char, 0> bitcode;
+		llvm::raw_svector_ostream OS(bitcode);
+		llvm::WriteBitcodeToFile(m, OS);
+		llvm::SHA1 hash;
+		hash.update(m_settings);
+		hash.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+		return llvm::toHex(hash.final(), true);
+	}
+
+	std::unique_ptr<llvm::MemoryBuffer> lookup(const std::string& key)
+	{
+		auto buffer = llvm::MemoryBuffer::getFile(getPath(key), false, false);
+		if (!buffer)
+		{
+			m_misses++;
+			return nullptr;
+		}
+		m_hits++;
+		return std::move(*buffer);
+	}
+
+	void store(const std::string& key, llvm::MemoryBufferRef obj)
+	{
+		llvm::SmallString<128> model(m_directory);
+		llvm::sys::path::append(model, "tmp-%%%%%%%%");
+		int fd;
+		llvm::SmallString<128> tmpPath;
+		if (llvm::sys::fs::createUniqueFile(model, fd, tmpPath))
+			return;
+		{
+			llvm::raw_fd_ostream OS(fd, true);
+			OS << obj.getBuffer();
+		}
+		if (llvm::sys::fs::rename(tmpPath, getPath(key)))
+		{
+			llvm::sys::fs::remove(tmpPath);
+			return;
+		}
+		if (m_sizeLimit)
+		{
+			llvm::CachePruningPolicy policy;
+			policy.Interval = std::chrono::seconds(0);
+			policy.MaxSizeBytes = m_sizeLimit;
+			llvm::pruneCache(m_directory, policy);
+		}
+	}
+
+	virtual void notifyObjectCompiled(const llvm::Module* m, llvm::MemoryBufferRef obj) override
+	{
+		store(getKey(*m), obj);
+	}
+
+	virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* m) override
+	{
+		return lookup(getKey(*m));
+	}
+
+	uint64_t getHits() const
+	{
+		return m_hits;
+	}
+	uint64_t getMisses() const
+	{
+		return m_misses;
+	}
+};
@@ -0,0 +1,229 @@
+#pragma once
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include "BoundsCheck.h"
+#include "MessageEngine.h"
+#include "Type.h"
+
+extern void Error(MessageEngine::Code code, std::string_view additionalMsg);
+extern void Info(MessageEngine::Code code, std::string_view additionalMsg);
+
+// `const fnc` functions can initialize globals: `lut -> slice<u8> : table(256);` calls the
+// function while compiling and stores its result as the global's initializer. The call runs
+// compiled, in a throwaway JIT holding a copy of the function and everything it calls, so a
+// const function is ordinary Du code with loops and allocations. A slice or arrayN result becomes a
+// private table the descriptor points to, so the program never builds it at startup. The table
+// is writable and laid out like a runtime block whose record has no base, so `delete` on it
+// returns without freeing anything.
+class ConstEvaluation final
+{
+public:
+	static constexpr const char* s_attribute = "du-const";
+	struct Request
+	{
+		std::string global;
+		std::string function;
+		std::vector<uint64_t> args;
+		Type* type;
+		// Du return type of the function; its signedness widens an integer result
+		Type* resultType = nullptr;
+	};
+	using SymbolRegistration = std::function<llvm::Error(llvm::orc::LLJIT&)>;
+private:
+	static constexpr const char* s_entry = "du.consteval";
+	// Words of the DuBlock record DuFunctions keeps in front of every block
+	static constexpr uint64_t s_blockWords = 4;
+	static inline std::vector<Request> s_requests;
+
+	static void fail(const Request& request, const std::string& reason)
+	{
+		Error(MessageEngine::Code::CONST_EVALUATION_FAILED, std::format("{} = {}(): {}", request.global, request.function, reason));
+	}
+
+	static std::set<const llvm::Function*> getReachable(llvm::Function* fn)
+	{
+		std::set<const llvm::Function*> reachable{ fn };
+		std::vector<llvm::Function*> worklist{ fn };
+		while (!worklist.empty())
+		{
+			llvm::Function* current = worklist.back();
+			worklist.pop_back();
+			for (llvm::Instruction& inst : llvm::instructions(*current))
+			{
+				auto* call = llvm::dyn_cast<llvm::CallBase>(&inst);
+				llvm::Function* callee = call ? call->getCalledFunction() : nullptr;
+				if (callee && !callee->isDeclaration() && reachable.insert(callee).second)
+					worklist.push_back(callee);
+			}
+		}
+		return reachable;
+	}
+
+	// `void du.consteval(i8* out)` stores the result of the requested call to `out`.
+	static void createEntry(llvm::Module& m, llvm::Function* fn, const Request& request)
+	{
+		llvm::IRBuilder<> b(m.getContext());
+		auto* entry = llvm::Function::Create(llvm::FunctionType::get(b.getVoidTy(), { b.getInt8PtrTy() }, false), llvm::GlobalValue::ExternalLinkage, s_entry, m);
+		b.SetInsertPoint(llvm::BasicBlock::Create(m.getContext(), "entry", entry));
+		std::vector<llvm::Value*> args;
+		for (size_t i = 0; i < request.args.size(); i++)
+		{
+			llvm::Type* type = fn->getFunctionType()->getParamType(static_cast<unsigned>(i));
+			if (type->isFloatingPointTy())
+				args.push_back(llvm::ConstantFP::get(type, static_cast<double>(static_cast<int64_t>(request.args[i]))));
+			else if (type->isIntegerTy())
+				args.push_back(llvm::ConstantInt::get(type, request.args[i], true));
+			else
+				fail(request, std::format("argument {} is not a number", i));
+		}
+		llvm::CallInst* result = b.CreateCall(fn, args);
+		result->setCallingConv(fn->getCallingConv());
+		b.CreateStore(result, b.CreateBitCast(entry->getArg(0), result->getType()->getPointerTo()));
+		b.CreateRetVoid();
+	}
+
+	static std::vector<char> execute(llvm::Module& m, llvm::Function* fn, const Request& request, llvm::orc::ThreadSafeContext context, const SymbolRegistration& registerSymbols, llvm::DataLayout& layout)
+	{
+		std::set<const llvm::Function*> reachable = getReachable(fn);
+		llvm::ValueToValueMapTy vmap;
+		std::unique_ptr<llvm::Module> copy = llvm::CloneModule(m, vmap, [&reachable](const llvm::GlobalValue* gv) {
+			auto* f = llvm::dyn_cast<llvm::Function>(gv);
+			return !f || reachable.count(f);
+		});
+		createEntry(*copy, copy->getFunction(fn->getName()), request);
+		auto jit = llvm::orc::LLJITBuilder().create();
+		if (!jit)
+			fail(request, llvm::toString(jit.takeError()));
+		if (auto err = registerSymbols(**jit))
+			fail(request, llvm::toString(std::move(err)));
+		if (auto err = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(copy), context)))
+			fail(request, llvm::toString(std::move(err)));
+		auto entry = (*jit)->lookup(s_entry);
+		if (!entry)
+			fail(request, llvm::toString(entry.takeError()));
+		layout = (*jit)->getDataLayout();
+		std::vector<char> result(layout.getTypeAllocSize(fn->getReturnType()));
+		llvm::jitTargetAddressToFunction<void(*)(char*)>(entry->getAddress())(result.data());
+		return result;
+	}
+
+	static llvm::Constant* toArrayConstant(llvm::Module& m, const llvm::DataLayout& layout, ArrayType* at, llvm::StructType* descriptor, const char* bytes, const Request& request)
+	{
+		llvm::Type* elementType = at->getElementType()->getLLVMType(m.getContext());
+		if (!llvm::ConstantDataSequential::isElementTypeCompatible(elementType))
+			fail(request, std::format("{} elements cannot form a constant table", at->getElementType()->getIdentifier().getName()));
+		const llvm::StructLayout* fields = layout.getStructLayout(descriptor);
+		const char* data = nullptr;
+		std::memcpy(&data, bytes + fields->getElementOffset(ArrayType::DATA), sizeof(data));
+		auto readArray = [&](unsigned field, std::vector<llvm::Constant*>& out) {
+			auto* type = llvm::cast<llvm::ArrayType>(descriptor->getElementType(field));
+			for (uint64_t i = 0; i < type->getNumElements(); i++)
+			{
+				uint64_t value = 0;
+				std::memcpy(&value, bytes + fields->getElementOffset(field) + i * sizeof(value), sizeof(value));
+				out.push_back(llvm::ConstantInt::get(type->getElementType(), value));
+			}
+			return llvm::ConstantArray::get(type, out);
+		};
+		std::vector<llvm::Constant*> extents;
+		std::vector<llvm::Constant*> strides;
+		llvm::Constant* extentsInit = readArray(ArrayType::EXTENTS, extents);
+		llvm::Constant* stridesInit = readArray(ArrayType::STRIDES, strides);
+		uint64_t count = 1;
+		for (llvm::Constant* extent : extents)
+			count *= llvm::cast<llvm::ConstantInt>(extent)->getZExtValue();
+		if (count && !data)
+			fail(request, "null table");
+		llvm::Constant* content = llvm::ConstantDataArray::getRaw(llvm::StringRef(data, count * layout.getTypeAllocSize(elementType)), count, elementType);
+		llvm::IntegerType* i64 = llvm::Type::getInt64Ty(m.getContext());
+		std::vector<llvm::Constant*> prefix;
+		if (BoundsCheck::isEnabled())
+			prefix.push_back(BoundsCheck::getConstantHeader(m.getContext(), count));
+		uint64_t size = layout.getTypeAllocSize(content->getType());
+		for (llvm::Constant* header : prefix)
+			size += layout.getTypeAllocSize(header->getType());
+		// { base, size, mapped, reserved }: a null base tells DuDeallocate the block is static
+		llvm::Constant* block = llvm::ConstantArray::get(llvm::ArrayType::get(i64, s_blockWords), { llvm::ConstantInt::get(i64, 0), llvm::ConstantInt::get(i64, size), llvm::ConstantInt::get(i64, 0), llvm::ConstantInt::get(i64, 0) });
+		prefix.insert(prefix.begin(), block);
+		prefix.push_back(content);
+		llvm::Constant* init = llvm::ConstantStruct::getAnon(m.getContext(), prefix);
+		auto* table = new llvm::GlobalVariable(m, init->getType(), false, llvm::GlobalValue::PrivateLinkage, init, request.global + ".table");
+		table->setAlignment(llvm::Align(std::max<uint64_t>(16, layout.getABITypeAlignment(elementType))));
+		llvm::Constant* zero = llvm::ConstantInt::get(i64, 0);
+		llvm::Constant* last = llvm::ConstantInt::get(llvm::Type::getInt32Ty(m.getContext()), prefix.size() - 1);
+		llvm::Constant* pointer = llvm::ConstantExpr::getInBoundsGetElementPtr(init->getType(), table, llvm::ArrayRef<llvm::Constant*>{ zero, last, zero });
+		return llvm::ConstantStruct::get(descriptor, { pointer, extentsInit, stridesInit });
+	}
+
+	static llvm::Constant* toConstant(llvm::Module& m, const llvm::DataLayout& layout, llvm::Type* resultType, const char* bytes, const Request& request)
+	{
+		llvm::Type* type = request.type->getLLVMType(m.getContext());
+		if (resultType->isIntegerTy() && type->isIntegerTy())
+		{
+			uint64_t value = 0;
+			std::memcpy(&value, bytes, layout.getTypeStoreSize(resultType));
+			const llvm::APInt result(resultType->getIntegerBitWidth(), value);
+			const unsigned bits = type->getIntegerBitWidth();
+			return llvm::ConstantInt::get(type, SimpleNumericType::isSignedSource(request.resultType) ? result.sextOrTrunc(bits) : result.zextOrTrunc(bits));
+		}
+		if (resultType != type)
+			fail(request, std::format("result does not match {}", request.type->getIdentifier().getName()));
+		if (type->isFloatTy())
+		{
+			float value;
+			std::memcpy(&value, bytes, sizeof(value));
+			return llvm::ConstantFP::get(type, value);
+		}
+		if (type->isDoubleTy())
+		{
+			double value;
+			std::memcpy(&value, bytes, sizeof(value));
+			return llvm::ConstantFP::get(type, value);
+		}
+		if (ArrayType* at = dynamic_cast<ArrayType*>(request.type))
+			return toArrayConstant(m, layout, at, llvm::cast<llvm::StructType>(type), bytes, request);
+		fail(request, std::format("{} cannot be a constant", request.type->getIdentifier().getName()));
+		return nullptr;
+	}
+
+public:
+	static void request(Request&& request)
+	{
+		s_requests.push_back(std::move(request));
+	}
+
+	// Evaluates every requested initializer in source order; a global padded by `align(N)`
+	// keeps the value in element 0.
+	static void run(llvm::Module& m, llvm::orc::ThreadSafeContext context, const SymbolRegistration& registerSymbols)
+	{
+		for (const Request& request : s_requests)
+		{
+			llvm::GlobalVariable* gv = m.getGlobalVariable(request.global);
+			llvm::Function* fn = m.getFunction(request.function);
+			if (!gv || !fn || !fn->hasFnAttribute(s_attribute))
+				fail(request, "not a const fnc");
+			if (fn->arg_size() != request.args.size())
+				fail(request, "wrong number of arguments");
+			llvm::DataLayout layout("");
+			std::vector<char> result = execute(m, fn, request, context, registerSymbols, layout);
+			llvm::Constant* init = toConstant(m, layout, fn->getReturnType(), result.data(), request);
+			if (auto* padded = llvm::dyn_cast<llvm::StructType>(gv->getValueType()); padded && padded != init->getType())
+				init = llvm::ConstantStruct::get(padded, { init, llvm::Constant::getNullValue(padded->getElementType(1)) });
+			gv->setInitializer(init);
+			Info(MessageEngine::Code::CONST_EVALUATION, std::format("{} = {}() ({} bytes)", request.global, request.function, layout.getTypeAllocSize(init->getType())));
+		}
+		s_requests.clear();
+	}
+};
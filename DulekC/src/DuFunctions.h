@@ -8,7 +8,16 @@ extern "C"
 {
 	DLLIMPORT int DuDisplay(const char*, ...);
 	DLLIMPORT int DuDisplayNumber(int32_t);
+	DLLIMPORT int DuDisplayFloat(double);
+	DLLIMPORT void DuPrintText(const char*, uint64_t);
+	DLLIMPORT void DuPrintNumber(int64_t);
+	DLLIMPORT void DuPrintUnsigned(uint64_t);
+	DLLIMPORT void DuPrintFloat(double);
 	DLLIMPORT uint8_t* DuAllocate(uint64_t);
+	DLLIMPORT uint8_t* DuAllocateAligned(uint64_t, uint64_t, uint64_t);
 	DLLIMPORT uint8_t* DuReallocate(uint64_t, uint8_t*);
 	DLLIMPORT void DuDeallocate(void*);
+	DLLIMPORT int32_t DuCpuFeatureLevel(void);
+	DLLIMPORT void DuWriteProfile(const char*, uint64_t, const uint64_t*, uint64_t);
+	DLLIMPORT void DuBoundsCheckFailed(int64_t, int64_t);
 }
\ No newline at end of file
@@ -35,6 +35,12 @@ public:
 		auto[ptr, errcode] = std::from_chars(m_id.data(), m_id.data() + m_id.size(), val);
 		return { errcode == std::errc() && ptr == (m_id.data() + m_id.size()), val };
 	}
+	const std::pair<bool, double> toFloatingPoint() const
+	{
+		double val;
+		auto[ptr, errcode] = std::from_chars(m_id.data(), m_id.data() + m_id.size(), val);
+		return { errcode == std::errc() && ptr == (m_id.data() + m_id.size()), val };
+	}
 };
 
 
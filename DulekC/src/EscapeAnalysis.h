@@ -0,0 +1,260 @@
+#pragma once
+#include <llvm/Analysis/ConstantFolding.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/LoopUtils.h>
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <vector>
+
+// Moves `new` allocations of a small constant size to the stack when the pointer never leaves
+// the function. The pointer may live in local variables, be indexed, compared, passed to memory
+// intrinsics and freed with `delete`; storing it anywhere else, passing it to a call or
+// returning it counts as an escape. A non-escaping allocation with a loop invariant size that
+// is freed on every iteration of its loop is first hoisted out of the loop and reused, which
+// also lets a small one reach the stack. Allocations still inside loops stay on the heap, so
+// one entry block slot never holds two live arrays.
+class EscapeAnalysis final
+{
+	static constexpr uint64_t s_maxStackBytes = 1024;
+
+	static bool isNull(llvm::Value* v)
+	{
+		return llvm::isa<llvm::ConstantPointerNull>(v);
+	}
+
+	static bool collectFrees(llvm::CallInst* allocation, llvm::Function* deallocate, std::vector<llvm::CallInst*>& frees)
+	{
+		std::set<llvm::Value*> derived;
+		std::vector<llvm::Value*> worklist;
+		std::vector<llvm::Instruction*> merges;
+		std::set<llvm::AllocaInst*> slots;
+		auto addDerived = [&](llvm::Value* v) {
+			if (derived.insert(v).second)
+				worklist.push_back(v);
+		};
+		addDerived(allocation);
+		while (!worklist.empty())
+		{
+			llvm::Value* v = worklist.back();
+			worklist.pop_back();
+			for (llvm::User* user : v->users())
+			{
+				auto* inst = llvm::dyn_cast<llvm::Instruction>(user);
+				if (!inst)
+					return false;
+				if (llvm::isa<llvm::BitCastInst>(inst) || llvm::isa<llvm::GetElementPtrInst>(inst))
+					addDerived(inst);
+				else if (llvm::isa<llvm::PHINode>(inst) || llvm::isa<llvm::SelectInst>(inst))
+				{
+					merges.push_back(inst);
+					addDerived(inst);
+				}
+				else if (llvm::isa<llvm::LoadInst>(inst) || llvm::isa<llvm::ICmpInst>(inst))
+					continue;
+				else if (auto* store = llvm::dyn_cast<llvm::StoreInst>(inst))
+				{
+					if (store->getValueOperand() != v)
+						continue;
+					auto* slot = llvm::dyn_cast<llvm::AllocaInst>(store->getPointerOperand());
+					if (!slot)
+						return false;
+					if (!slots.insert(slot).second)
+						continue;
+					for (llvm::User* slotUser : slot->users())
+					{
+						if (auto* load = llvm::dyn_cast<llvm::LoadInst>(slotUser))
+							addDerived(load);
+						else if (auto* slotStore = llvm::dyn_cast<llvm::StoreInst>(slotUser); !slotStore || slotStore->getPointerOperand() != slot)
+							return false;
+					}
+				}
+				else if (auto* call = llvm::dyn_cast<llvm::CallInst>(inst))
+				{
+					if (call->getCalledFunction() == deallocate)
+						frees.push_back(call);
+					else if (!llvm::isa<llvm::MemIntrinsic>(call))
+						return false;
+				}
+				else
+					return false;
+			}
+		}
+		// Variables and merges may only ever hold this allocation or null
+		for (llvm::AllocaInst* slot : slots)
+		{
+			for (llvm::User* slotUser : slot->users())
+			{
+				auto* store = llvm::dyn_cast<llvm::StoreInst>(slotUser);
+				if (store && !derived.count(store->getValueOperand()) && !isNull(store->getValueOperand()))
+					return false;
+			}
+		}
+		for (llvm::Instruction* merge : merges)
+		{
+			for (unsigned i = llvm::isa<llvm::SelectInst>(merge) ? 1 : 0; i < merge->getNumOperands(); i++)
+			{
+				if (!derived.count(merge->getOperand(i)) && !isNull(merge->getOperand(i)))
+					return false;
+			}
+		}
+		return !frees.empty();
+	}
+
+	static std::optional<uint64_t> getConstantSize(llvm::CallInst* call)
+	{
+		auto* size = llvm::dyn_cast<llvm::Constant>(call->getArgOperand(0));
+		if (!size)
+			return std::nullopt;
+		auto* folded = llvm::dyn_cast<llvm::ConstantInt>(llvm::ConstantFoldConstant(size, call->getModule()->getDataLayout()));
+		if (!folded)
+			return std::nullopt;
+		return folded->getZExtValue();
+	}
+
+	static bool isAllocation(llvm::CallInst* call)
+	{
+		llvm::Function* callee = call->getCalledFunction();
+		return callee && (callee->getName() == "DuAllocate" || callee->getName() == "DuAllocateAligned");
+	}
+
+	// Alignment a stack copy of the block needs; none for `new<N>` in -bounds-check mode, where
+	// the runtime aligns an address past the returned pointer.
+	static std::optional<uint64_t> getStackAlignment(llvm::CallInst* call)
+	{
+		constexpr uint64_t defaultAlignment = 16;
+		if (call->arg_size() == 1)
+			return defaultAlignment;
+		auto* alignment = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(1));
+		auto* offset = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(2));
+		if (!alignment || !offset || !offset->isZero())
+			return std::nullopt;
+		return std::max(defaultAlignment, alignment->getZExtValue());
+	}
+
+	static std::vector<llvm::CallInst*> getAllocations(llvm::Function& fn)
+	{
+		std::vector<llvm::CallInst*> allocations;
+		for (llvm::Instruction& inst : llvm::instructions(fn))
+		{
+			auto* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+			if (call && isAllocation(call))
+				allocations.push_back(call);
+		}
+		return allocations;
+	}
+
+	// A `return` inside the loop body leaves through a block ending in `ret`.
+	static bool hasReturn(llvm::Loop* loop)
+	{
+		llvm::SmallVector<llvm::BasicBlock*, 4> exits;
+		loop->getUniqueExitBlocks(exits);
+		exits.append(loop->block_begin(), loop->block_end());
+		return std::any_of(exits.begin(), exits.end(), [](llvm::BasicBlock* bb) {
+			return std::any_of(bb->begin(), bb->end(), [](llvm::Instruction& inst) { return llvm::isa<llvm::ReturnInst>(inst); });
+		});
+	}
+
+	// `buf = new T(n)` ... `delete buf` in a loop body becomes one allocation in the preheader,
+	// freed on the loop exits. A free that follows the allocation and precedes every back edge
+	// guarantees no two iterations' blocks are alive at once. Loops with a `return` in the body
+	// are left alone. Hoists one allocation at a time, since making the preheader and the
+	// dedicated exits changes the CFG.
+	static bool hoistOutOfLoop(llvm::Function& fn, llvm::Function* deallocate)
+	{
+		std::vector<llvm::CallInst*> allocations = getAllocations(fn);
+		if (allocations.empty())
+			return false;
+		llvm::DominatorTree dt(fn);
+		llvm::LoopInfo li(dt);
+		for (llvm::CallInst* allocation : allocations)
+		{
+			llvm::Loop* loop = li.getLoopFor(allocation->getParent());
+			llvm::Value* size = allocation->getArgOperand(0);
+			if (!loop || !loop->isLoopInvariant(size) || hasReturn(loop))
+				continue;
+			if (auto* sizeInst = llvm::dyn_cast<llvm::Instruction>(size); sizeInst && !dt.dominates(sizeInst, loop->getHeader()))
+				continue;
+			std::vector<llvm::CallInst*> frees;
+			if (!collectFrees(allocation, deallocate, frees))
+				continue;
+			llvm::SmallVector<llvm::BasicBlock*, 4> latches;
+			loop->getLoopLatches(latches);
+			auto freedEveryIteration = [&](llvm::CallInst* free) {
+				return li.getLoopFor(free->getParent()) == loop && dt.dominates(allocation, free)
+					&& std::all_of(latches.begin(), latches.end(), [&](llvm::BasicBlock* latch) { return dt.dominates(free->getParent(), latch); });
+			};
+			auto insideLoop = [&](llvm::CallInst* free) { return loop->contains(free); };
+			if (!std::all_of(frees.begin(), frees.end(), insideLoop) || !std::any_of(frees.begin(), frees.end(), freedEveryIteration))
+				continue;
+
+			llvm::BasicBlock* preheader = loop->getLoopPreheader();
+			if (!preheader)
+				preheader = llvm::InsertPreheaderForLoop(loop, &dt, &li, nullptr, false);
+			if (!preheader)
+				continue;
+			llvm::formDedicatedExitBlocks(loop, &dt, &li, nullptr, false);
+			allocation->moveBefore(preheader->getTerminator());
+			for (llvm::CallInst* free : frees)
+				free->eraseFromParent();
+			llvm::SmallVector<llvm::BasicBlock*, 4> exits;
+			loop->getUniqueExitBlocks(exits);
+			for (llvm::BasicBlock* exit : exits)
+				llvm::CallInst::Create(deallocate->getFunctionType(), deallocate, { allocation }, "", &*exit->getFirstInsertionPt());
+			return true;
+		}
+		return false;
+	}
+
+	static bool promote(llvm::Function& fn, llvm::Function* deallocate)
+	{
+		std::vector<llvm::CallInst*> allocations = getAllocations(fn);
+		if (allocations.empty())
+			return false;
+		llvm::DominatorTree dt(fn);
+		llvm::LoopInfo li(dt);
+		bool changed = false;
+		for (llvm::CallInst* allocation : allocations)
+		{
+			std::optional<uint64_t> size = getConstantSize(allocation);
+			std::optional<uint64_t> alignment = getStackAlignment(allocation);
+			std::vector<llvm::CallInst*> frees;
+			if (!size || !alignment || !*size || *size > s_maxStackBytes || li.getLoopFor(allocation->getParent()) || !collectFrees(allocation, deallocate, frees))
+				continue;
+			llvm::IRBuilder<> b(&*fn.getEntryBlock().getFirstInsertionPt());
+			llvm::ArrayType* type = llvm::ArrayType::get(b.getInt8Ty(), *size);
+			llvm::AllocaInst* stack = b.CreateAlloca(type, nullptr, "stack_array");
+			stack->setAlignment(llvm::Align(*alignment));
+			b.SetInsertPoint(allocation);
+			allocation->replaceAllUsesWith(b.CreateConstInBoundsGEP2_64(type, stack, 0, 0));
+			allocation->eraseFromParent();
+			for (llvm::CallInst* free : frees)
+				free->eraseFromParent();
+			changed = true;
+		}
+		return changed;
+	}
+
+public:
+	static bool run(llvm::Module& m)
+	{
+		llvm::Function* deallocate = m.getFunction("DuDeallocate");
+		if (!deallocate)
+			return false;
+		bool changed = false;
+		for (llvm::Function& fn : m)
+		{
+			if (fn.isDeclaration())
+				continue;
+			while (hoistOutOfLoop(fn, deallocate))
+				changed = true;
+			changed |= promote(fn, deallocate);
+		}
+		return changed;
+	}
+};
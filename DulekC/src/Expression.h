@@ -9,7 +9,9 @@
 #include "GenTmpVariables.h"
 #include "SystemFunctions.h"
 #include "LLvmBuilder.h"
+#include "BoundsCheck.h"
 #include "ValueWrapper.h"
+#include <format>
 
 
 class Expression : public DuObject
@@ -103,6 +105,11 @@ public:
 	{
 		return m_tv & ( TypeValue::LVAL & 0xFE);
 	}
+	// The result wrapper holds the address of the value rather than the value.
+	virtual bool yieldsAddress() const
+	{
+		return false;
+	}
 
 };
 
@@ -119,6 +126,115 @@ class AdvancedExpression : public Expression
 		assert(0);
 	}
 
+	// Operands are variables, literals wrapped as values, or array elements wrapped as addresses.
+	static Type* getOperandType(Expression* e)
+	{
+		return e->isExprValueWrapper() ? e->getResWrapper()->getType() : e->getRes()->getType();
+	}
+	static llvm::Value* loadOperand(llvm::IRBuilder<>& builder, Expression* e)
+	{
+		if (!e->isExprValueWrapper())
+			return LlvmBuilder::loadValue(builder, e->getRes());
+		ValueWrapper* wrapper = e->getResWrapper();
+		if (e->yieldsAddress())
+			return builder.CreateLoad(wrapper->getType()->getLLVMType(builder.getContext()), wrapper->getValue());
+		return wrapper->getValue();
+	}
+	// Integer and floating point operands meet in the floating point type, f32 and f64 in f64;
+	// a scalar and a vector meet in the vector type.
+	static Type* getOperationType(Type* l, Type* r)
+	{
+		if (dynamic_cast<VectorType*>(l))
+			return l;
+		if (dynamic_cast<VectorType*>(r))
+			return r;
+		if (r->isFloatingPointType() && (!l->isFloatingPointType() || r->getSizeInBytes() > l->getSizeInBytes()))
+			return r;
+		return l;
+	}
+
+	void processFloatingPointExpression(llvm::IRBuilder<>& builder, llvm::LLVMContext& context, Type* type, char op)
+	{
+		llvm::Value* lVal = loadOperand(builder, m_l);
+		llvm::Value* rVal = loadOperand(builder, m_r);
+		lVal = type->convertValueBasedOnType(builder, lVal, lVal->getType(), context, SimpleNumericType::isSignedSource(getOperandType(m_l)));
+		rVal = type->convertValueBasedOnType(builder, rVal, rVal->getType(), context, SimpleNumericType::isSignedSource(getOperandType(m_r)));
+		llvm::Value* result = nullptr;
+		switch (op)
+		{
+		case '+':
+			result = builder.CreateFAdd(lVal, rVal);
+			break;
+		case '-':
+			result = builder.CreateFSub(lVal, rVal);
+			break;
+		case '*':
+			result = builder.CreateFMul(lVal, rVal);
+			break;
+		case '/':
+			result = builder.CreateFDiv(lVal, rVal);
+			break;
+		}
+		Variable* newVar = new Variable("res+", type, nullptr, false);
+		newVar = LlvmBuilder::assigmentValue(builder, newVar, result);
+		setRes(newVar);
+	}
+
+	// Lane-wise arithmetic, or a lane-wise comparison producing a vec<bool, N> mask.
+	void processVectorExpression(llvm::IRBuilder<>& builder, llvm::LLVMContext& context, VectorType* type, char op, bool compare)
+	{
+		Type* lType = getOperandType(m_l);
+		Type* rType = getOperandType(m_r);
+		if (dynamic_cast<VectorType*>(lType) && dynamic_cast<VectorType*>(rType) && lType != rType)
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, std::string(lType->getIdentifier().getName()) + " " + op + " " + std::string(rType->getIdentifier().getName()));
+		llvm::Value* lVal = loadOperand(builder, m_l);
+		llvm::Value* rVal = loadOperand(builder, m_r);
+		lVal = type->convertValueBasedOnType(builder, lVal, lVal->getType(), context, SimpleNumericType::isSignedSource(lType));
+		rVal = type->convertValueBasedOnType(builder, rVal, rVal->getType(), context, SimpleNumericType::isSignedSource(rType));
+		const bool isFloatingPoint = type->getElementType()->isFloatingPointType();
+		const bool isSigned = type->isSigned();
+		Type* resultType = type;
+		llvm::Value* result = nullptr;
+		if (compare)
+		{
+			TypeContainer& tc = TypeContainer::instance();
+			resultType = tc.getVectorType(tc.getNumericType(ObjectInByte::BOOLEAN, false), type->getLanes());
+			switch (op)
+			{
+			case '>':
+				result = isFloatingPoint ? builder.CreateFCmpOGT(lVal, rVal, ">") : isSigned ? builder.CreateICmpSGT(lVal, rVal, ">") : builder.CreateICmpUGT(lVal, rVal, ">");
+				break;
+			case '<':
+				result = isFloatingPoint ? builder.CreateFCmpOLT(lVal, rVal, "<") : isSigned ? builder.CreateICmpSLT(lVal, rVal, "<") : builder.CreateICmpULT(lVal, rVal, "<");
+				break;
+			default:
+				result = isFloatingPoint ? builder.CreateFCmpOEQ(lVal, rVal, "==") : builder.CreateICmpEQ(lVal, rVal, "==");
+				break;
+			}
+		}
+		else
+		{
+			switch (op)
+			{
+			case '+':
+				result = isFloatingPoint ? builder.CreateFAdd(lVal, rVal) : builder.CreateAdd(lVal, rVal);
+				break;
+			case '-':
+				result = isFloatingPoint ? builder.CreateFSub(lVal, rVal) : builder.CreateSub(lVal, rVal);
+				break;
+			case '*':
+				result = isFloatingPoint ? builder.CreateFMul(lVal, rVal) : builder.CreateMul(lVal, rVal);
+				break;
+			case '/':
+				result = isFloatingPoint ? builder.CreateFDiv(lVal, rVal) : isSigned ? builder.CreateSDiv(lVal, rVal) : builder.CreateUDiv(lVal, rVal);
+				break;
+			}
+		}
+		Variable* newVar = new Variable("res+", resultType, nullptr, false);
+		newVar = LlvmBuilder::assigmentValue(builder, newVar, result);
+		setRes(newVar);
+	}
+
 	void processMathematicalExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool s, char op)
 	{
 		Variable* var1 = m_l->getRes();
@@ -160,41 +276,65 @@ class AdvancedExpression : public Expression
 		return '\0';
 	}
 
-	void processBooleanExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool s, char op)
+	// Ordered comparisons: any comparison with a NaN is false.
+	llvm::Value* compareFloatingPoint(llvm::IRBuilder<>& builder, llvm::LLVMContext& context, Type* type, char op)
 	{
-		Variable* var1 = m_l->getRes();
-		Variable* var2 = m_r->getRes();
-		llvm::Value* lVal = LlvmBuilder::loadValue(builder, var1);
-		llvm::Value* rVal = LlvmBuilder::loadValue(builder, var2);
-		rVal = var1->getType()->convertValueBasedOnType(builder, rVal, rVal->getType(), context);
-		llvm::Value* result = nullptr;
+		llvm::Value* lVal = loadOperand(builder, m_l);
+		llvm::Value* rVal = loadOperand(builder, m_r);
+		lVal = type->convertValueBasedOnType(builder, lVal, lVal->getType(), context, SimpleNumericType::isSignedSource(getOperandType(m_l)));
+		rVal = type->convertValueBasedOnType(builder, rVal, rVal->getType(), context, SimpleNumericType::isSignedSource(getOperandType(m_r)));
 		switch (op)
 		{
 		case '>':
-			if(!s)
-				result = builder.CreateICmpUGT(lVal, rVal, ">");
-			else
-				result = builder.CreateICmpSGT(lVal, rVal, ">");
-			break;
+			return builder.CreateFCmpOGT(lVal, rVal, ">");
 		case '<':
-			if(!s)
-				result = builder.CreateICmpULT(lVal, rVal, "<");
-			else
-				result = builder.CreateICmpSLT(lVal, rVal, "<");
-			break;
+			return builder.CreateFCmpOLT(lVal, rVal, "<");
 		default:
+			return builder.CreateFCmpOEQ(lVal, rVal, "==");
+		}
+	}
+
+	void processBooleanExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool s, char op)
+	{
+		Type* type = getOperationType(getOperandType(m_l), getOperandType(m_r));
+		llvm::Value* result = nullptr;
+		if (type->isFloatingPointType())
+			result = compareFloatingPoint(builder, context, type, op);
+		else
+		{
+			Variable* var1 = m_l->getRes();
+			Variable* var2 = m_r->getRes();
+			llvm::Value* lVal = LlvmBuilder::loadValue(builder, var1);
+			llvm::Value* rVal = LlvmBuilder::loadValue(builder, var2);
+			rVal = var1->getType()->convertValueBasedOnType(builder, rVal, rVal->getType(), context);
+			switch (op)
 			{
-				std::string_view  opStr = getIdentifier().getName();
-				if (!opStr.compare("=="))
+			case '>':
+				if(!s)
+					result = builder.CreateICmpUGT(lVal, rVal, ">");
+				else
+					result = builder.CreateICmpSGT(lVal, rVal, ">");
+				break;
+			case '<':
+				if(!s)
+					result = builder.CreateICmpULT(lVal, rVal, "<");
+				else
+					result = builder.CreateICmpSLT(lVal, rVal, "<");
+				break;
+			default:
 				{
-					result = builder.CreateICmpEQ(lVal, rVal, "==");
+					std::string_view  opStr = getIdentifier().getName();
+					if (!opStr.compare("=="))
+					{
+						result = builder.CreateICmpEQ(lVal, rVal, "==");
+					}
+					else
+						assert(0);
 				}
-				else
-					assert(0);
 			}
 		}
 		assert(result->getType()->isIntegerTy(1));
-		Variable* res = new Variable("", TypeContainer::instance().getType(Type::getName(Type::ID::BOOL)), nullptr, false);
+		Variable* res = new Variable("", TypeContainer::instance().getNumericType(ObjectInByte::BOOLEAN, false), nullptr, false);
 		res->setBooleanValue();
 		res = LlvmBuilder::assigmentValue(builder,  res, result);
 		setRes(res);
@@ -222,11 +362,15 @@ public:
 		char op = isMathematicalExpression();
 		if (op)
 		{
-			Variable* var = m_l->getRes();
-			if (var->isPointer())
+			Type* type = getOperationType(getOperandType(m_l), getOperandType(m_r));
+			if (dynamic_cast<PointerType*>(type))
 			{
 				processPointerExpression(module, builder, op);
 			}
+			else if (VectorType* vt = dynamic_cast<VectorType*>(type))
+				processVectorExpression(builder, context, vt, op, false);
+			else if (type->isFloatingPointType())
+				processFloatingPointExpression(builder, context, type, op);
 			else
 				processMathematicalExpression(module, builder, context, s, op);
 			return;
@@ -234,7 +378,12 @@ public:
 		op = isBooleanExpression();
 		if (op)
 		{
-			auto lt = m_l->getRes()->getType();
+			if (VectorType* vt = dynamic_cast<VectorType*>(getOperationType(getOperandType(m_l), getOperandType(m_r))))
+			{
+				processVectorExpression(builder, context, vt, op, true);
+				return;
+			}
+			auto lt = getOperandType(m_l);
 			if (lt && lt->isSimpleNumericType())
 			{
 				s = static_cast<SimpleNumericType*>(lt)->isSigned();
@@ -256,7 +405,18 @@ public:
 class CallFunctionExpression : public Expression
 {
 	std::vector<Identifier> m_args;
-	Function* m_fun;
+	mutable Function* m_fun;
+	Identifier m_callee;
+
+	// A generic instance is declared after the body calling it, so its call binds by name.
+	Function* resolve() const
+	{
+		if (!m_fun)
+			m_fun = AstTree::instance().findFunction(m_callee);
+		if (!m_fun)
+			Error(MessageEngine::Code::WRONG_ARGUMENT, m_callee.getName());
+		return m_fun;
+	}
 
 	llvm::Value* processUserFunc(llvm::IRBuilder<>& builder, llvm::LLVMContext& context, llvm::Module* m) const 
 	{
@@ -281,11 +441,69 @@ class CallFunctionExpression : public Expression
 					llvm::Value* val = LlvmBuilder::loadValue(builder, _arg);
 					args.push_back(val);
 				}
+				else if (ArrayType* at = dynamic_cast<ArrayType*>(_arg->getType()))
+					LlvmBuilder::flattenArray(builder, LlvmBuilder::loadValue(builder, _arg), at->getRank(), args);
 				else
 					args.push_back(arg->getLLVMValue(arg->getLLVMType(context)));
 			}
 		}
-		return builder.CreateCall(m_fun->getLLVMFunction(context, m, builder), args);
+		return builder.CreateCall(m_fun->getLLVMCallee(context, m), args);
+	}
+	Variable* getPointerArgument(size_t i) const
+	{
+		Variable* arg = dynamic_cast<Variable*>(AstTree::instance().findObject(m_args[i]));
+		if (!arg || !arg->isPointer())
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[i].getName());
+		return arg;
+	}
+	llvm::Value* loadArgument(llvm::IRBuilder<>& builder, size_t i, llvm::Type* numberType) const
+	{
+		auto [isNumber, val] = m_args[i].toNumber();
+		auto arg = AstTree::instance().findObject(m_args[i]);
+		if (!arg && isNumber)
+			return llvm::ConstantInt::get(numberType, val);
+		if (!arg || !arg->isVariable())
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[i].getName());
+		return LlvmBuilder::loadValue(builder, static_cast<Variable*>(arg));
+	}
+	// $copy/$move(dst, src, count) and $fill/$stream_store(dst, value, count); count is in
+	// elements of dst's pointee type.
+	void processBulkMemoryFunc(SystemFunctions::SysFunctionID id, llvm::IRBuilder<>& builder, llvm::LLVMContext& context) const
+	{
+		if (m_args.size() != 3)
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, m_fun->getIdentifier().getName());
+		Variable* dst = getPointerArgument(0);
+		Type* elementType = static_cast<PointerType*>(dst->getType())->getPtrType();
+		llvm::Type* type = elementType->getLLVMType(context);
+		llvm::Value* dstPtr = LlvmBuilder::loadValue(builder, dst);
+		llvm::Value* counts = loadArgument(builder, 2, builder.getInt64Ty());
+		if (!counts->getType()->isIntegerTy())
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[2].getName());
+		switch (id)
+		{
+		case SystemFunctions::SysFunctionID::COPY_MEMORY:
+		case SystemFunctions::SysFunctionID::MOVE_MEMORY:
+		{
+			llvm::Value* srcPtr = builder.CreatePointerCast(LlvmBuilder::loadValue(builder, getPointerArgument(1)), dstPtr->getType());
+			LlvmBuilder::copyMemory(builder, dstPtr, srcPtr, type, counts, id == SystemFunctions::SysFunctionID::MOVE_MEMORY);
+			break;
+		}
+		default:
+		{
+			llvm::Value* value = loadArgument(builder, 1, type->isIntegerTy() ? type : builder.getInt64Ty());
+			if (value->getType() != type && !(value->getType()->isIntegerTy() && type->isIntegerTy()))
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[1].getName());
+			LlvmBuilder::fillMemory(builder, dstPtr, value, type, counts, id == SystemFunctions::SysFunctionID::STREAM_STORE);
+			break;
+		}
+		}
+	}
+	bool isFloatingPointArgument(size_t i) const
+	{
+		if (i >= m_args.size())
+			return false;
+		Variable* arg = dynamic_cast<Variable*>(AstTree::instance().findObject(m_args[i]));
+		return arg && arg->getType()->isFloatingPointType();
 	}
 	llvm::Value* processSystemFunc(llvm::FunctionCallee* fc, llvm::IRBuilder<>& builder, llvm::LLVMContext& context)
 	{
@@ -319,15 +537,30 @@ class CallFunctionExpression : public Expression
 				Variable* _arg = static_cast<Variable*>(arg);
 				args.push_back(LlvmBuilder::loadValue(builder, _arg));
 			}
+			if (args[i]->getType()->isFloatTy() && fc->getFunctionType()->getParamType(i)->isDoubleTy())
+				args[i] = builder.CreateFPExt(args[i], builder.getDoubleTy());
 			if (args[i]->getType() != fc->getFunctionType()->getParamType(i))
 				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, nullptr);
 		}
+		// With -bounds-check every block the program sees sits behind a header, like `new`'s
+		if (BoundsCheck::isEnabled())
+		{
+			const SystemFunctions::SysFunctionID id = SystemFunctions::getSysFunctionID(m_fun->getIdentifier());
+			if (id == SystemFunctions::SysFunctionID::ALLOCATE_MEMORY)
+				return BoundsCheck::allocate(builder, builder.getInt64(1), args[0], fc);
+			if (id == SystemFunctions::SysFunctionID::DEALLOCATE_MEMORY)
+				args[0] = BoundsCheck::getAllocation(builder, args[0]);
+		}
 		return builder.CreateCall(*fc, args);
 	}
 
 
 public:
-	CallFunctionExpression(std::vector<Identifier>&& args, Function* fun) : Expression(Identifier("CallFunctionExpr")), m_args(std::move(args)), m_fun(fun)
+	CallFunctionExpression(std::vector<Identifier>&& args, Function* fun) : CallFunctionExpression(std::move(args), fun, fun ? fun->getIdentifier() : Identifier(""))
+	{}
+	CallFunctionExpression(std::vector<Identifier>&& args, Identifier callee) : CallFunctionExpression(std::move(args), nullptr, callee)
+	{}
+	CallFunctionExpression(std::vector<Identifier>&& args, Function* fun, Identifier callee) : Expression(Identifier("CallFunctionExpr")), m_args(std::move(args)), m_fun(fun), m_callee(callee)
 	{
 		AstTree& tree = AstTree::instance();
 		for (auto it : m_args)
@@ -343,7 +576,7 @@ public:
 	}
 	virtual llvm::Type* getLLVMType(llvm::LLVMContext& context) const override
 	{
-		return m_fun->getLLVMType(context);
+		return resolve()->getLLVMType(context);
 	}
 	virtual llvm::Value* getLLVMValue(llvm::Type* type) const override
 	{
@@ -352,12 +585,21 @@ public:
 
 	virtual void processExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool) override
 	{
+		resolve();
 		bool isSystemFun = m_fun->getIdentifier().getName().data()[0] == '$';
 		llvm::Value* result = nullptr;
+		const SystemFunctions::SysFunctionID sysId = SystemFunctions::getSysFunctionID(m_fun->getIdentifier());
+		if (isSystemFun && SystemFunctions::isBulkMemoryFunction(sysId))
+		{
+			processBulkMemoryFunc(sysId, builder, context);
+			return;
+		}
 		if (isSystemFun)
 		{
 			SystemFunctions* sf = SystemFunctions::GetSystemFunctions(module, &builder, &context);
 			auto callee = sf->findFunction(m_fun->getIdentifier());
+			if (sysId == SystemFunctions::SysFunctionID::DISPLAY && isFloatingPointArgument(0))
+				callee = sf->findFunction(Identifier(SystemFunctions::s_displayFloat));
 			if (callee)
 				result = processSystemFunc(callee,  builder, context);
 			else
@@ -403,7 +645,12 @@ public:
 			if (isNumber)
 			{
 				llvm::Value* initVal = llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), val);
-				setRes(new ValueWrapper("const val", initVal, TypeContainer::instance().getType(Type::generateId(ObjectInByte::DWORD, true))));
+				setRes(new ValueWrapper("const val", initVal, TypeContainer::instance().getNumericType(ObjectInByte::DWORD, true)));
+			}
+			else if (auto [isFloatingPoint, fp] = getIdentifier().toFloatingPoint(); isFloatingPoint)
+			{
+				llvm::Value* initVal = llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), fp);
+				setRes(new ValueWrapper("const val", initVal, TypeContainer::instance().getFloatingPointType(ObjectInByte::QWORD)));
 			}
 
 		}
@@ -414,25 +661,344 @@ public:
 
 
 
+// `$print("n = ", n, "\n")` writes its arguments in order without a format string. Literals,
+// numbers included, are joined into text at parse time; text is one private constant per
+// distinct literal, written with its length. Variables are written by the runtime entry for
+// their kind: signed, unsigned or floating point.
+class PrintExpression : public Expression
+{
+public:
+	struct Part
+	{
+		std::string text;
+		Identifier arg;
+		bool isText;
+	};
+private:
+	std::vector<Part> m_parts;
+
+	void printVariable(SystemFunctions* sf, llvm::IRBuilder<>& builder, Variable* var) const
+	{
+		llvm::Value* value = LlvmBuilder::loadValue(builder, var);
+		if (var->getType()->isFloatingPointType())
+		{
+			if (value->getType()->isFloatTy())
+				value = builder.CreateFPExt(value, builder.getDoubleTy());
+			builder.CreateCall(*sf->findFunction(Identifier(SystemFunctions::s_printFloat)), { value });
+			return;
+		}
+		if (!var->getType()->isSimpleNumericType() || !value->getType()->isIntegerTy())
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, var->getIdentifier().getName());
+		const bool isSigned = static_cast<SimpleNumericType*>(var->getType())->isSigned() && !value->getType()->isIntegerTy(1);
+		value = builder.CreateIntCast(value, builder.getInt64Ty(), isSigned);
+		builder.CreateCall(*sf->findFunction(Identifier(isSigned ? SystemFunctions::s_printNumber : SystemFunctions::s_printUnsigned)), { value });
+	}
+public:
+	PrintExpression(std::vector<Part>&& parts) : Expression(Identifier("PrintExpr"))
+	{
+		for (Part& part : parts)
+		{
+			if (!part.isText && !dynamic_cast<Variable*>(AstTree::instance().findObject(part.arg)))
+				Error(MessageEngine::Code::WRONG_ARGUMENT, part.arg.getName());
+			if (part.isText && part.text.empty())
+				continue;
+			if (part.isText && !m_parts.empty() && m_parts.back().isText)
+				m_parts.back().text += part.text;
+			else
+				m_parts.push_back(std::move(part));
+		}
+	}
+	virtual void processExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool) override
+	{
+		SystemFunctions* sf = SystemFunctions::GetSystemFunctions(module, &builder, &context);
+		for (const Part& part : m_parts)
+		{
+			if (!part.isText)
+				printVariable(sf, builder, static_cast<Variable*>(AstTree::instance().findObject(part.arg)));
+			else
+				builder.CreateCall(*sf->findFunction(Identifier(SystemFunctions::s_printText)), { sf->getStringLiteral(part.text), builder.getInt64(part.text.size()) });
+		}
+	}
+};
+
+
+// SIMD builtins. $extract(v, i) reads a lane and $insert(v, x, i) returns v with lane i set to x.
+// $shuffle(a, b, l0, l1, ...) picks lanes of a followed by b by constant index; with only a,
+// $shuffle(a, l0, ...) permutes it. $select(mask, a, b) takes a where the mask is set.
+// $load<N>(p, i) and $store(p, i, v) move the N elements from p[i] on and expect them
+// aligned to the whole vector, as `new<N>` provides.
+class VectorExpression : public Expression
+{
+public:
+	enum class Op : uint8_t
+	{
+		EXTRACT,
+		INSERT,
+		SHUFFLE,
+		SELECT,
+		LOAD,
+		STORE,
+	};
+private:
+	Op m_op;
+	std::vector<Identifier> m_args;
+	uint32_t m_lanes;
+
+	Variable* getVariable(size_t i) const
+	{
+		Variable* arg = i < m_args.size() ? dynamic_cast<Variable*>(AstTree::instance().findObject(m_args[i])) : nullptr;
+		if (!arg)
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, i < m_args.size() ? m_args[i].getName() : getIdentifier().getName());
+		return arg;
+	}
+	VectorType* getVectorType(size_t i) const
+	{
+		VectorType* vt = dynamic_cast<VectorType*>(getVariable(i)->getType());
+		if (!vt)
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[i].getName());
+		return vt;
+	}
+	Type* getPointeeType(size_t i) const
+	{
+		PointerType* pt = dynamic_cast<PointerType*>(getVariable(i)->getType());
+		if (!pt || !(pt->getPtrType()->isSimpleNumericType() || pt->getPtrType()->isFloatingPointType()))
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[i].getName());
+		return pt->getPtrType();
+	}
+	bool isConstant(size_t i) const
+	{
+		return m_args[i].toNumber().first && !AstTree::instance().findObject(m_args[i]);
+	}
+	llvm::Value* loadArgument(llvm::IRBuilder<>& builder, size_t i, llvm::Type* numberType) const
+	{
+		if (isConstant(i))
+			return llvm::ConstantInt::get(numberType, m_args[i].toNumber().second);
+		return LlvmBuilder::loadValue(builder, getVariable(i));
+	}
+	llvm::Value* loadLane(llvm::IRBuilder<>& builder, size_t i, uint32_t lanes) const
+	{
+		if (isConstant(i) && m_args[i].toNumber().second >= lanes)
+			Error(MessageEngine::Code::WRONG_ARGUMENT, m_args[i].getName());
+		return loadArgument(builder, i, builder.getInt32Ty());
+	}
+	void checkArguments(size_t count) const
+	{
+		if (m_args.size() != count)
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, getIdentifier().getName());
+	}
+	// Address of p[i] as a vector of `lanes` elements; bounds checked up to the last lane.
+	llvm::Value* getVectorAddress(llvm::IRBuilder<>& builder, llvm::LLVMContext& context, Type* element, uint32_t lanes) const
+	{
+		llvm::Value* base = LlvmBuilder::loadValue(builder, getVariable(0));
+		llvm::Value* index = builder.CreateIntCast(loadArgument(builder, 1, builder.getInt64Ty()), builder.getInt64Ty(), true);
+		if (BoundsCheck::isEnabled())
+			BoundsCheck::emitCheck(builder, base, builder.CreateAdd(index, builder.getInt64(lanes - 1)));
+		llvm::Value* address = LlvmBuilder::arrayOperator(builder, base, index, element->getLLVMType(context));
+		return builder.CreateBitCast(address, llvm::FixedVectorType::get(element->getLLVMType(context), lanes)->getPointerTo());
+	}
+
+	void processShuffle(llvm::IRBuilder<>& builder, llvm::LLVMContext& context)
+	{
+		if (m_args.size() < 2)
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, getIdentifier().getName());
+		VectorType* vt = getVectorType(0);
+		llvm::Value* first = LlvmBuilder::loadValue(builder, getVariable(0));
+		llvm::Value* second = llvm::PoisonValue::get(first->getType());
+		size_t maskBegin = 1;
+		if (!isConstant(1))
+		{
+			if (getVectorType(1) != vt)
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[1].getName());
+			second = LlvmBuilder::loadValue(builder, getVariable(1));
+			maskBegin = 2;
+		}
+		const uint64_t sources = maskBegin * vt->getLanes();
+		std::vector<int> mask;
+		for (size_t i = maskBegin; i < m_args.size(); i++)
+		{
+			if (!isConstant(i) || m_args[i].toNumber().second >= sources)
+				Error(MessageEngine::Code::WRONG_ARGUMENT, m_args[i].getName());
+			mask.push_back(static_cast<int>(m_args[i].toNumber().second));
+		}
+		if (!VectorType::isValidLaneCount(mask.size()))
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, getIdentifier().getName());
+		VectorType* resultType = TypeContainer::instance().getVectorType(vt->getElementType(), static_cast<uint32_t>(mask.size()));
+		setRes(new ValueWrapper("vector_value", builder.CreateShuffleVector(first, second, mask, "shuffle"), resultType));
+	}
+
+public:
+	VectorExpression(Op op, std::vector<Identifier>&& args, uint32_t lanes = 0) : Expression(Identifier(getName(op))), m_op(op), m_args(std::move(args)), m_lanes(lanes)
+	{
+		if (m_op == Op::LOAD && !VectorType::isValidLaneCount(m_lanes))
+			Error(MessageEngine::Code::WRONG_ARGUMENT, "$load<" + std::to_string(m_lanes) + ">");
+	}
+	static const char* getName(Op op)
+	{
+		switch (op)
+		{
+		case Op::EXTRACT:
+			return "$extract";
+		case Op::INSERT:
+			return "$insert";
+		case Op::SHUFFLE:
+			return "$shuffle";
+		case Op::SELECT:
+			return "$select";
+		case Op::LOAD:
+			return "$load";
+		default:
+			return "$store";
+		}
+	}
+
+	virtual void processExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool s) override
+	{
+		switch (m_op)
+		{
+		case Op::EXTRACT:
+		{
+			checkArguments(2);
+			VectorType* vt = getVectorType(0);
+			llvm::Value* vector = LlvmBuilder::loadValue(builder, getVariable(0));
+			setRes(new ValueWrapper("lane_value", builder.CreateExtractElement(vector, loadLane(builder, 1, vt->getLanes()), "extract"), vt->getElementType()));
+			break;
+		}
+		case Op::INSERT:
+		{
+			checkArguments(3);
+			VectorType* vt = getVectorType(0);
+			llvm::Value* vector = LlvmBuilder::loadValue(builder, getVariable(0));
+			llvm::Type* elementType = vt->getElementType()->getLLVMType(context);
+			llvm::Value* value = loadArgument(builder, 1, elementType->isIntegerTy() ? elementType : builder.getInt64Ty());
+			value = vt->getElementType()->convertValueBasedOnType(builder, value, value->getType(), context);
+			setRes(new ValueWrapper("vector_value", builder.CreateInsertElement(vector, value, loadLane(builder, 2, vt->getLanes()), "insert"), vt));
+			break;
+		}
+		case Op::SHUFFLE:
+			processShuffle(builder, context);
+			break;
+		case Op::SELECT:
+		{
+			checkArguments(3);
+			VectorType* mask = getVectorType(0);
+			VectorType* vt = getVectorType(1);
+			if (!mask->isMask() || getVectorType(2) != vt || mask->getLanes() != vt->getLanes())
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, getIdentifier().getName());
+			llvm::Value* condition = LlvmBuilder::loadValue(builder, getVariable(0));
+			llvm::Value* selected = builder.CreateSelect(condition, LlvmBuilder::loadValue(builder, getVariable(1)), LlvmBuilder::loadValue(builder, getVariable(2)), "select");
+			setRes(new ValueWrapper("vector_value", selected, vt));
+			break;
+		}
+		case Op::LOAD:
+		{
+			checkArguments(2);
+			Type* element = getPointeeType(0);
+			VectorType* vt = TypeContainer::instance().getVectorType(element, m_lanes);
+			llvm::Value* address = getVectorAddress(builder, context, element, m_lanes);
+			llvm::Value* vector = builder.CreateAlignedLoad(vt->getLLVMType(context), address, llvm::Align(vt->getSizeInBytes()), "vector_load");
+			setRes(new ValueWrapper("vector_value", vector, vt));
+			break;
+		}
+		case Op::STORE:
+		{
+			checkArguments(3);
+			Type* element = getPointeeType(0);
+			VectorType* vt = getVectorType(2);
+			if (vt->getElementType() != element)
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[2].getName());
+			llvm::Value* address = getVectorAddress(builder, context, element, vt->getLanes());
+			builder.CreateAlignedStore(LlvmBuilder::loadValue(builder, getVariable(2)), address, llvm::Align(vt->getSizeInBytes()));
+			break;
+		}
+		}
+	}
+	virtual ~VectorExpression() {}
+};
+
+
+
 class AllocExpression : public Expression
 {
 	Type* m_type;
-	Expression* m_counts;
+	std::vector<Expression*> m_counts;
+	uint64_t m_alignment;
 public:
-	AllocExpression(Type* type, Expression* counts) : m_type(type), m_counts(counts), Expression("AllocaExpression")
+	// `new T(n)` takes one count; `new arrayN<T>(e0, ..., eN-1)` one extent per dimension.
+	// `new<N> T(n)` aligns the first element to N bytes, N a power of two.
+	AllocExpression(Type* type, std::vector<Expression*> counts, uint64_t alignment = 0) : Expression("AllocaExpression"), m_type(type), m_counts(std::move(counts)), m_alignment(alignment)
 	{
+		ArrayType* at = dynamic_cast<ArrayType*>(type);
+		if (m_counts.size() != (at ? at->getRank() : 1))
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, "new");
+		if (m_alignment & (m_alignment - 1))
+			Error(MessageEngine::Code::WRONG_ARGUMENT, "new<" + std::to_string(m_alignment) + ">");
 	}
+	// `new soa<R>(n)` carves every field array out of one block; the first array starts the block,
+	// and the arrays are ordered by decreasing alignment so each one starts aligned.
+	void processSoa(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, SoaType* st)
+	{
+		RecordType* rt = st->getRecordType();
+		m_counts.front()->processExpression(module, builder, context, false);
+		Variable* countsVar = m_counts.front()->getRes();
+		llvm::Value* counts = countsVar->getLLVMValue(countsVar->getLLVMType(context));
+		std::vector<std::pair<unsigned, llvm::Type*>> fields;
+		llvm::Constant* size_of = builder.getInt64(0);
+		for (unsigned i : st->getAllocationOrder())
+		{
+			llvm::Type* fieldType = rt->getField(i).type->getLLVMType(context);
+			fields.emplace_back(i, fieldType);
+			size_of = llvm::ConstantExpr::getAdd(size_of, llvm::ConstantExpr::getSizeOf(fieldType));
+		}
+		SystemFunctions* sf = SystemFunctions::GetSystemFunctions(module, &builder, &context);
+		llvm::FunctionCallee* callee = sf->findFunction(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::ALLOCATE_MEMORY));
+		uint64_t alignment = std::max<uint64_t>(m_alignment, rt->getField(st->getAllocationOrder().front()).type->getAlignmentInBytes());
+		if (alignment > SystemFunctions::s_defaultAlignment)
+			callee = sf->findFunction(Identifier(SystemFunctions::s_allocateAligned));
+		else
+			alignment = 0;
+		llvm::Value* allocatedMemory = BoundsCheck::isEnabled() ? BoundsCheck::allocate(builder, size_of, counts, callee, alignment) : LlvmBuilder::allocate(builder, size_of, counts, callee, alignment);
+		setRes(new ValueWrapper("allocated_value", LlvmBuilder::makeSoa(builder, st->getLLVMType(context), allocatedMemory, counts, fields), m_type));
+	}
+
 	virtual void processExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool s)
 	{
+		if (SoaType* st = dynamic_cast<SoaType*>(m_type))
+		{
+			processSoa(module, builder, context, st);
+			return;
+		}
 		auto& tree = AstTree::instance();
-		llvm::Type* type = m_type->getLLVMType(context);
+		ArrayType* at = dynamic_cast<ArrayType*>(m_type);
+		Type* elementType = at ? at->getElementType() : m_type;
+		llvm::Type* type = elementType->getLLVMType(context);
 		llvm::Constant* size_of = llvm::ConstantExpr::getSizeOf(type);
-		m_counts->processExpression(module, builder, context, s);
-		Variable* countsVar = m_counts->getRes();
-		llvm::Value* counts = countsVar->getLLVMValue(countsVar->getLLVMType(context));
+		std::vector<llvm::Value*> extents;
+		for (Expression* it : m_counts)
+		{
+			it->processExpression(module, builder, context, s);
+			Variable* countsVar = it->getRes();
+			extents.push_back(countsVar->getLLVMValue(countsVar->getLLVMType(context)));
+		}
+		llvm::Value* counts = extents.front();
+		if (at)
+		{
+			for (llvm::Value*& extent : extents)
+				extent = builder.CreateIntCast(extent, builder.getInt64Ty(), false);
+			counts = extents.front();
+			for (size_t i = 1; i < extents.size(); i++)
+				counts = builder.CreateNUWMul(counts, extents[i], "elements");
+		}
 		SystemFunctions* sf = SystemFunctions::GetSystemFunctions(module, &builder, &context);
 		llvm::FunctionCallee* callee = sf->findFunction(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::ALLOCATE_MEMORY));
-		llvm::Value* allocatedMemory = LlvmBuilder::allocate ( builder, size_of, counts, callee );
+		// vec<T, N> elements need their whole size aligned, more than DuAllocate guarantees for wide ones
+		uint64_t alignment = std::max<uint64_t>(m_alignment, elementType->getAlignmentInBytes());
+		if (alignment > SystemFunctions::s_defaultAlignment)
+			callee = sf->findFunction(Identifier(SystemFunctions::s_allocateAligned));
+		else
+			alignment = 0;
+		llvm::Value* allocatedMemory = BoundsCheck::isEnabled() ? BoundsCheck::allocate(builder, size_of, counts, callee, alignment) : LlvmBuilder::allocate ( builder, size_of, counts, callee, alignment );
+		if (at)
+			allocatedMemory = LlvmBuilder::makeArray(builder, at->getLLVMType(context), allocatedMemory, extents);
 		setRes(new ValueWrapper("allocated_value", allocatedMemory, m_type));
 	}
 };
@@ -448,7 +1014,7 @@ public:
 		auto obj = tree.findObject(id);
 		if (Variable* var = dynamic_cast<Variable*>(obj))
 		{
-			if (var->isPointer())
+			if (var->isPointer() || var->isArray() || dynamic_cast<SoaType*>(var->getType()))
 			{
 				m_obj = var;
 			}
@@ -466,8 +1032,17 @@ public:
 		SystemFunctions* sf = SystemFunctions::GetSystemFunctions(module, &builder, &context);
 		llvm::FunctionCallee* callee = sf->findFunction(SystemFunctions::getSysFunctionName(SystemFunctions::SysFunctionID::DEALLOCATE_MEMORY));
 		llvm::Value* ptrToDelete = LlvmBuilder::loadValue(builder, m_obj);
+		SoaType* st = dynamic_cast<SoaType*>(m_obj->getType());
+		if (m_obj->isArray())
+			ptrToDelete = builder.CreateExtractValue(ptrToDelete, { ArrayType::DATA });
+		else if (st)
+			ptrToDelete = builder.CreateExtractValue(ptrToDelete, { st->getAllocationOrder().front() });
 		assert(ptrToDelete && ptrToDelete->getType()->isPointerTy());
+		if (BoundsCheck::isEnabled())
+			ptrToDelete = BoundsCheck::getAllocation(builder, ptrToDelete);
 		llvm::Value* resVal = LlvmBuilder::deallocate(builder, ptrToDelete, callee);
+		if (m_obj->isArray() || st)
+			resVal = llvm::Constant::getNullValue(m_obj->getLLVMType(context));
 		LlvmBuilder::assigmentValue(builder, m_obj, resVal);
 	}
 };
@@ -494,6 +1069,10 @@ public:
 			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, "");
 		m_dims.emplace_back(expr);
 	}
+	virtual bool yieldsAddress() const override
+	{
+		return true;
+	}
 
 	virtual void processExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool) override
 	{
@@ -520,6 +1099,13 @@ public:
 			}
 			_type = t;
 		}
+		if (ArrayType* at = dynamic_cast<ArrayType*>(_type))
+		{
+			processArrayN(module, builder, context, at, addressArr);
+			return;
+		}
+		if (dynamic_cast<SoaType*>(_type))
+			Error(MessageEngine::Code::WRONG_ARGUMENT, "soa element needs a field: " + std::string(getObjectName()));
 		Type* nextType = nullptr;
 		for (auto& it : m_dims)
 		{
@@ -540,6 +1126,9 @@ public:
 
 			if (!dimVal || !addressArr->getType()->isPointerTy())
 				Error(MessageEngine::Code::WRONG_ARGUMENT, "dimension for array operator called");
+			// Only the base pointer comes from `new`; deeper dimensions index into its elements
+			if (BoundsCheck::isEnabled() && &it == &m_dims.front())
+				BoundsCheck::emitCheck(builder, addressArr, dimVal);
 			addressArr = LlvmBuilder::arrayOperator(builder, addressArr, dimVal, ptit.getValue()->getLLVMType(context));
 			_type = ptit.getValue();
 			ptit = ptit.getNext();
@@ -548,4 +1137,156 @@ public:
 		setRes(new ValueWrapper("tmp_value_from_address", addressArr, _type));
 	}
 
-};
\ No newline at end of file
+	std::string_view getObjectName() const
+	{
+		return m_object->getIdentifier().getName();
+	}
+
+	// `s[i]` on a soa<R> names no storage by itself; FieldAccessExpression asks for one field instead.
+	SoaType* getStructOfArrays() const
+	{
+		Type* t = m_object->isValueWrapper() ? dynamic_cast<ValueWrapper*>(m_object)->getType() : dynamic_cast<Variable*>(m_object)->getType();
+		return dynamic_cast<SoaType*>(t);
+	}
+
+	// Address of element i of the field array; the block header in front of the first allocated
+	// field holds the element count for -bounds-check.
+	void processSoaField(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, unsigned field)
+	{
+		SoaType* st = getStructOfArrays();
+		if (m_dims.size() != 1)
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, st->getIdentifier().getName());
+		llvm::Value* soa = m_object->isValueWrapper() ? dynamic_cast<ValueWrapper*>(m_object)->getValue() : LlvmBuilder::loadValue(builder, dynamic_cast<Variable*>(m_object));
+		Expression* dim = m_dims.front().get();
+		dim->processExpression(module, builder, context, true);
+		llvm::Value* index = nullptr;
+		if (dim->isValueWrapper())
+			index = dim->getResWrapper() ? dim->getResWrapper()->getValue() : nullptr;
+		else if (Variable* res = dim->getRes())
+			index = res->getLLVMValue(res->getLLVMType(context));
+		if (!index)
+			Error(MessageEngine::Code::WRONG_ARGUMENT, "dimension for array operator called");
+		if (BoundsCheck::isEnabled())
+			BoundsCheck::emitCheck(builder, builder.CreateExtractValue(soa, { st->getAllocationOrder().front() }), index);
+		Type* fieldType = st->getRecordType()->getField(field).type;
+		llvm::Value* fieldArray = builder.CreateExtractValue(soa, { field }, "soa_field");
+		setRes(new ValueWrapper("tmp_value_from_address", LlvmBuilder::arrayOperator(builder, fieldArray, index, fieldType->getLLVMType(context)), fieldType));
+	}
+
+	void processArrayN(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, ArrayType* at, llvm::Value* array)
+	{
+		if (m_dims.size() != at->getRank())
+			Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, at->getIdentifier().getName());
+		std::vector<llvm::Value*> indexes;
+		for (auto& it : m_dims)
+		{
+			it->processExpression(module, builder, context, true);
+			llvm::Value* dimVal = nullptr;
+			if (it->isValueWrapper())
+			{
+				ValueWrapper* wrapper = it->getResWrapper();
+				dimVal = wrapper ? wrapper->getValue() : nullptr;
+			}
+			else
+			{
+				Variable* res = it->getRes();
+				dimVal = res ? res->getLLVMValue(res->getLLVMType(context)) : nullptr;
+			}
+			if (!dimVal)
+				Error(MessageEngine::Code::WRONG_ARGUMENT, "dimension for array operator called");
+			llvm::Value* index = builder.CreateIntCast(dimVal, builder.getInt64Ty(), true);
+			if (BoundsCheck::isEnabled())
+				BoundsCheck::emitExtentCheck(builder, index, builder.CreateExtractValue(array, { ArrayType::EXTENTS, static_cast<unsigned>(indexes.size()) }));
+			indexes.push_back(index);
+		}
+		Type* elementType = at->getElementType();
+		setRes(new ValueWrapper("tmp_value_from_address", LlvmBuilder::arrayElement(builder, array, elementType->getLLVMType(context), indexes), elementType));
+	}
+
+};
+
+
+
+// `base.field` on a record variable, a record element `p[i]` or another field; `s[i].field` on a
+// soa<R> indexes the field's own array. Like an array element the result is an address.
+class FieldAccessExpression : public Expression
+{
+	Variable* m_object = nullptr;
+	std::unique_ptr<Expression> m_base;
+	Identifier m_field;
+
+	static unsigned findField(RecordType* rt, const Identifier& field)
+	{
+		const unsigned index = rt->findField(field);
+		if (index == rt->getFieldCount())
+			Error(MessageEngine::Code::WRONG_ARGUMENT, std::format("{} has no field {}", rt->getIdentifier().getName(), field.getName()));
+		return index;
+	}
+
+	// Storage of a record variable; a global padded by `align(N)` keeps the record in element 0.
+	static llvm::Value* getVariableAddress(llvm::Module* module, llvm::IRBuilder<>& builder, Variable* var)
+	{
+		if (var->isGlobalVariable())
+		{
+			llvm::GlobalVariable* gv = module->getGlobalVariable(var->getIdentifier().getName());
+			if (gv->getValueType() != var->getLLVMType(builder.getContext()))
+				return builder.CreateStructGEP(gv->getValueType(), gv, 0);
+			return gv;
+		}
+		if (!var->getAlloca())
+			var->init(builder.CreateAlloca(var->getLLVMType(builder.getContext()), nullptr, var->getIdentifier().getName()), builder);
+		return var->getAlloca();
+	}
+public:
+	FieldAccessExpression(Identifier id, Identifier field) : Expression("Field_access_expr", TypeValue::LVAL), m_field(field)
+	{
+		setLHSFlag();
+		m_object = dynamic_cast<Variable*>(AstTree::instance().findObject(id));
+		if (!m_object)
+			Error(MessageEngine::Code::WRONG_ARGUMENT, id.getName());
+		if (!dynamic_cast<RecordType*>(m_object->getType()))
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, id.getName());
+		findField(static_cast<RecordType*>(m_object->getType()), m_field);
+	}
+	FieldAccessExpression(Expression* base, Identifier field) : Expression("Field_access_expr", TypeValue::LVAL), m_base(base), m_field(field)
+	{
+		setLHSFlag();
+	}
+	virtual bool yieldsAddress() const override
+	{
+		return true;
+	}
+
+	virtual void processExpression(llvm::Module* module, llvm::IRBuilder<>& builder, llvm::LLVMContext& context, bool s) override
+	{
+		if (auto* aoe = dynamic_cast<ArrayOperatorExprerssion*>(m_base.get()); aoe && aoe->getStructOfArrays())
+		{
+			aoe->processSoaField(module, builder, context, findField(aoe->getStructOfArrays()->getRecordType(), m_field));
+			ValueWrapper* element = aoe->getResWrapper();
+			setRes(new ValueWrapper("tmp_value_from_address", element->getValue(), element->getType()));
+			return;
+		}
+		llvm::Value* address = nullptr;
+		Type* type = nullptr;
+		if (m_object)
+		{
+			address = getVariableAddress(module, builder, m_object);
+			type = m_object->getType();
+		}
+		else
+		{
+			m_base->processExpression(module, builder, context, s);
+			if (!m_base->isExprValueWrapper())
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_field.getName());
+			address = m_base->getResWrapper()->getValue();
+			type = m_base->getResWrapper()->getType();
+		}
+		RecordType* rt = dynamic_cast<RecordType*>(type);
+		if (!rt)
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_field.getName());
+		const unsigned field = findField(rt, m_field);
+		Type* fieldType = rt->getField(field).type;
+		address = builder.CreateStructGEP(rt->getLLVMType(context), address, rt->getElementIndex(field), m_field.getName());
+		setRes(new ValueWrapper("tmp_value_from_address", address, fieldType));
+	}
+};
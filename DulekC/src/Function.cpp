@@ -2,21 +2,39 @@
 
 #include "Scope.h"
 #include "LLvmBuilder.h"
+#include "MultiVersioning.h"
+#include "CallSiteSpecialization.h"
+#include "ConstEvaluation.h"
 llvm::Function* Function::getLLVMFunction(llvm::LLVMContext& context, llvm::Module* m, llvm::IRBuilder<>& b)
 {
 	if (!m_llvmFunction)
 	{
-		m_llvmFunction = llvm::Function::Create(getFunctionType(context), llvm::Function::ExternalLinkage, getIdentifier().getName().data(), m);
+		m_llvmFunction = m->getFunction(getIdentifier().getName());
+		if (!m_llvmFunction)
+			m_llvmFunction = llvm::Function::Create(getFunctionType(context), llvm::Function::ExternalLinkage, getIdentifier().getName().data(), m);
+		addParameterAttributes(m_llvmFunction);
+		if (hasAttribute(MULTIVERSION))
+			m_llvmFunction->addFnAttr(MultiVersioning::s_attribute);
+		if (hasAttribute(SPECIALIZE))
+			m_llvmFunction->addFnAttr(CallSiteSpecialization::s_attribute);
+		if (hasAttribute(CONSTEVAL))
+			m_llvmFunction->addFnAttr(ConstEvaluation::s_attribute);
+		setFastMath(m_llvmFunction, b);
 		b.SetInsertPoint(getBasicBlock(context, m_llvmFunction));
 		if (!m_args.empty())
 		{
-			if (m_llvmFunction->arg_size() == m_args.size())
+			if (m_llvmFunction->arg_size() == getFunctionType(context)->getNumParams())
 			{
+				llvm::Function::arg_iterator arg = m_llvmFunction->arg_begin();
 				for (size_t i = 0; i < m_args.size(); i++)
 				{
-					auto arg = m_llvmFunction->getArg(i);
 					Variable* v = static_cast<Variable*>(AstTree::instance().findObject(m_args[i]));
-					v = LlvmBuilder::assigmentValue(b, v, arg);
+					llvm::Value* value = nullptr;
+					if (ArrayType* at = dynamic_cast<ArrayType*>(m_typesArgs[i]))
+						value = LlvmBuilder::unflattenArray(b, at->getLLVMType(context), arg, at->getRank());
+					else
+						value = &*arg++;
+					v = LlvmBuilder::assigmentValue(b, v, value);
 					v->setParent(this);
 				}
 			}
@@ -28,4 +46,53 @@ llvm::Function* Function::getLLVMFunction(llvm::LLVMContext& context, llvm::Modu
 		}
 	}
 	return m_llvmFunction;
+}
+
+// The body is emitted right after this, so the builder's flags apply to exactly this function's
+// floating point operations; reassociation is what lets the vectorizer split a reduction.
+void Function::setFastMath(llvm::Function* fn, llvm::IRBuilder<>& b) const
+{
+	llvm::FastMathFlags flags;
+	if (isFastMath())
+	{
+		flags.setFast();
+		for (const char* attribute : { "unsafe-fp-math", "no-nans-fp-math", "no-infs-fp-math", "no-signed-zeros-fp-math", "approx-func-fp-math" })
+			fn->addFnAttr(attribute, "true");
+	}
+	b.setFastMathFlags(flags);
+}
+
+// `restrict` promises the argument overlaps no other argument and, for a pointer, refers to at
+// least one element; slice and arrayN data is always element aligned, since it comes from `new`.
+void Function::addParameterAttributes(llvm::Function* fn) const
+{
+	const llvm::DataLayout& dl = fn->getParent()->getDataLayout();
+	unsigned index = 0;
+	for (size_t i = 0; i < m_typesArgs.size(); i++)
+	{
+		if (ArrayType* at = dynamic_cast<ArrayType*>(m_typesArgs[i]))
+		{
+			llvm::Type* element = at->getElementType()->getLLVMType(fn->getContext());
+			fn->addParamAttr(index, llvm::Attribute::getWithAlignment(fn->getContext(), dl.getABITypeAlign(element)));
+			if (isRestrictArgument(i))
+				fn->addParamAttr(index, llvm::Attribute::NoAlias);
+			index += at->getFieldCount();
+			continue;
+		}
+		if (PointerType* pt = dynamic_cast<PointerType*>(m_typesArgs[i]); pt && isRestrictArgument(i))
+		{
+			llvm::Type* element = pt->getPtrType()->getLLVMType(fn->getContext());
+			fn->addParamAttr(index, llvm::Attribute::NoAlias);
+			fn->addParamAttr(index, llvm::Attribute::getWithAlignment(fn->getContext(), dl.getABITypeAlign(element)));
+			fn->addDereferenceableParamAttr(index, dl.getTypeAllocSize(element));
+		}
+		index++;
+	}
+}
+
+llvm::FunctionCallee Function::getLLVMCallee(llvm::LLVMContext& context, llvm::Module* m) const
+{
+	if (llvm::Function* fn = m->getFunction(getIdentifier().getName()))
+		return fn;
+	return m->getOrInsertFunction(getIdentifier().getName(), createFunctionType(context));
 }
\ No newline at end of file
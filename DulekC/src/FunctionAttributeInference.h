@@ -0,0 +1,146 @@
+#pragma once
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <map>
+
+// Infers nounwind/readnone/readonly/norecurse for Du functions from their bodies and turns
+// self-calls whose result is returned directly into musttail calls. Memory touched only
+// through the function's own allocas does not count as a memory access.
+class FunctionAttributeInference final
+{
+	enum class MemoryAccess : uint8_t
+	{
+		NONE = 0,
+		READ,
+		WRITE,
+	};
+
+	static bool isLocalMemory(llvm::Value* ptr)
+	{
+		return llvm::isa<llvm::AllocaInst>(llvm::getUnderlyingObject(ptr));
+	}
+
+	static MemoryAccess getCalleeAccess(llvm::CallBase* call, const std::map<llvm::Function*, MemoryAccess>& known)
+	{
+		llvm::Function* callee = call->getCalledFunction();
+		if (!callee)
+			return MemoryAccess::WRITE;
+		auto it = known.find(callee);
+		if (it != known.end())
+			return it->second;
+		if (callee->doesNotAccessMemory())
+			return MemoryAccess::NONE;
+		if (callee->onlyReadsMemory())
+			return MemoryAccess::READ;
+		return MemoryAccess::WRITE;
+	}
+
+	static bool isCalleeNoUnwind(llvm::CallBase* call, const std::map<llvm::Function*, bool>& known)
+	{
+		llvm::Function* callee = call->getCalledFunction();
+		if (!callee)
+			return false;
+		auto it = known.find(callee);
+		return it != known.end() ? it->second : callee->doesNotThrow();
+	}
+
+	static void inferMemoryAndUnwind(llvm::Module& m)
+	{
+		std::map<llvm::Function*, MemoryAccess> access;
+		std::map<llvm::Function*, bool> noUnwind;
+		for (llvm::Function& fn : m)
+		{
+			if (fn.isDeclaration())
+				continue;
+			access[&fn] = MemoryAccess::NONE;
+			noUnwind[&fn] = true;
+		}
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (auto& [fn, fnAccess] : access)
+			{
+				MemoryAccess result = MemoryAccess::NONE;
+				bool unwind = false;
+				for (llvm::Instruction& inst : llvm::instructions(*fn))
+				{
+					MemoryAccess current = MemoryAccess::NONE;
+					if (auto* load = llvm::dyn_cast<llvm::LoadInst>(&inst))
+						current = isLocalMemory(load->getPointerOperand()) ? MemoryAccess::NONE : MemoryAccess::READ;
+					else if (auto* store = llvm::dyn_cast<llvm::StoreInst>(&inst))
+						current = isLocalMemory(store->getPointerOperand()) ? MemoryAccess::NONE : MemoryAccess::WRITE;
+					else if (auto* call = llvm::dyn_cast<llvm::CallBase>(&inst))
+					{
+						current = getCalleeAccess(call, access);
+						unwind |= !isCalleeNoUnwind(call, noUnwind);
+					}
+					else if (inst.mayWriteToMemory())
+						current = MemoryAccess::WRITE;
+					result = std::max(result, current);
+				}
+				if (result != fnAccess)
+				{
+					fnAccess = result;
+					changed = true;
+				}
+				if (unwind && noUnwind[fn])
+				{
+					noUnwind[fn] = false;
+					changed = true;
+				}
+			}
+		}
+		for (auto& [fn, fnAccess] : access)
+		{
+			if (fnAccess == MemoryAccess::NONE)
+				fn->setDoesNotAccessMemory();
+			else if (fnAccess == MemoryAccess::READ)
+				fn->setOnlyReadsMemory();
+			if (noUnwind[fn])
+				fn->setDoesNotThrow();
+		}
+	}
+
+	static void inferNoRecurse(llvm::Module& m)
+	{
+		llvm::CallGraph cg(m);
+		for (auto it = llvm::scc_begin(&cg); !it.isAtEnd(); ++it)
+		{
+			const std::vector<llvm::CallGraphNode*>& scc = *it;
+			if (scc.size() != 1 || it.hasCycle())
+				continue;
+			llvm::Function* fn = scc.front()->getFunction();
+			if (fn && !fn->isDeclaration())
+				fn->setDoesNotRecurse();
+		}
+	}
+
+	static void markSelfTailCalls(llvm::Module& m)
+	{
+		for (llvm::Function& fn : m)
+		{
+			for (llvm::Instruction& inst : llvm::instructions(fn))
+			{
+				auto* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+				if (!call || call->getCalledFunction() != &fn || call->getCallingConv() != fn.getCallingConv())
+					continue;
+				auto* ret = llvm::dyn_cast_or_null<llvm::ReturnInst>(call->getNextNode());
+				if (ret && (fn.getReturnType()->isVoidTy() || ret->getReturnValue() == call))
+					call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+			}
+		}
+	}
+
+public:
+	static void run(llvm::Module& m)
+	{
+		inferMemoryAndUnwind(m);
+		inferNoRecurse(m);
+		markSelfTailCalls(m);
+	}
+};
@@ -0,0 +1,201 @@
+#include "Generics.h"
+#include "AstTree.h"
+#include "MessageEngine.h"
+#include "Scope.h"
+#include "TypeContainer.h"
+#include "Variable.h"
+#include "parser.hpp"
+#include <format>
+
+extern void Error(MessageEngine::Code code, std::string_view additionalMsg);
+extern void Info(MessageEngine::Code code, std::string_view additionalMsg);
+
+// The recorded tokens are `(args) -> R (types) { body }`; only the positions where each
+// parameter type starts are kept, deduction walks the tokens from there.
+GenericFunction::GenericFunction(Identifier name, std::vector<Identifier>&& typeParams, std::vector<GenericToken>&& tokens, uint32_t attributes)
+	: m_name(name), m_typeParams(std::move(typeParams)), m_tokens(std::move(tokens)), m_attributes(attributes)
+{
+	size_t pos = 0;
+	auto expect = [&](int id) {
+		if (pos >= m_tokens.size() || m_tokens[pos].id != id)
+			Error(MessageEngine::Code::ERROR_TOKEN, m_name.getName());
+		pos++;
+	};
+	expect(LBRACE);
+	while (pos < m_tokens.size() && m_tokens[pos].id != RBRACE)
+		pos++;
+	expect(RBRACE);
+	expect(ARROW);
+	while (pos < m_tokens.size() && m_tokens[pos].id != LBRACE)
+		pos++;
+	expect(LBRACE);
+	int depth = 0;
+	bool startsType = true;
+	for (; pos < m_tokens.size() && (depth || m_tokens[pos].id != RBRACE); pos++)
+	{
+		const int id = m_tokens[pos].id;
+		if (startsType && id != RESTRICT_KEYWORD)
+		{
+			m_paramTypes.push_back(pos);
+			startsType = false;
+		}
+		if (id == LT)
+			depth++;
+		else if (id == GT)
+			depth--;
+		else if (id == COMMA && !depth)
+			startsType = true;
+	}
+	expect(RBRACE);
+}
+
+size_t GenericFunction::findTypeParam(const GenericToken& token) const
+{
+	if (token.id != IDENTIFIER)
+		return m_typeParams.size();
+	for (size_t i = 0; i < m_typeParams.size(); i++)
+	{
+		if (m_typeParams[i] == Identifier(token.text))
+			return i;
+	}
+	return m_typeParams.size();
+}
+
+// Walks the declared type starting at `pos` alongside `type`; returns the position after it.
+size_t GenericFunction::deduce(size_t pos, Type* type, std::vector<Type*>& bound) const
+{
+	const GenericToken& token = m_tokens[pos];
+	auto element = [&](Type* elementType) {
+		if (!elementType)
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, std::format("{} for {}", type->getIdentifier().getName(), m_name.getName()));
+		size_t next = deduce(pos + 2, elementType, bound);
+		if (token.id == VEC)
+			next += 2;
+		return next + 1;
+	};
+	switch (token.id)
+	{
+	case IDENTIFIER:
+	{
+		const size_t param = findTypeParam(token);
+		if (param < bound.size())
+		{
+			if (bound[param] && bound[param] != type)
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, std::format("{} of {} is both {} and {}", token.text, m_name.getName(), bound[param]->getIdentifier().getName(), type->getIdentifier().getName()));
+			bound[param] = type;
+		}
+		return pos + 1;
+	}
+	case PTR:
+	{
+		PointerType* pt = dynamic_cast<PointerType*>(type);
+		return element(pt ? pt->getPtrType() : nullptr);
+	}
+	case ARRAY:
+	case SLICE:
+	{
+		ArrayType* at = dynamic_cast<ArrayType*>(type);
+		return element(at ? at->getElementType() : nullptr);
+	}
+	case VEC:
+	{
+		VectorType* vt = dynamic_cast<VectorType*>(type);
+		return element(vt ? vt->getElementType() : nullptr);
+	}
+	case SOA:
+	{
+		SoaType* st = dynamic_cast<SoaType*>(type);
+		return element(st ? st->getRecordType() : nullptr);
+	}
+	default:
+		return pos + 1;
+	}
+}
+
+std::vector<Type*> GenericFunction::deduceTypes(const std::vector<Identifier>& args) const
+{
+	if (args.size() != m_paramTypes.size())
+		Error(MessageEngine::Code::INVALID_NUMBER_OF_ARGUMENTS, m_name.getName());
+	AstTree& tree = AstTree::instance();
+	std::vector<Type*> bound(m_typeParams.size(), nullptr);
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		if (Variable* var = dynamic_cast<Variable*>(tree.findObject(args[i])))
+			deduce(m_paramTypes[i], var->getType(), bound);
+		else if (!args[i].toNumber().first)
+			Error(MessageEngine::Code::WRONG_ARGUMENT, args[i].getName());
+	}
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const size_t pos = m_paramTypes[i];
+		const bool plainParam = m_tokens[pos + 1].id == COMMA || m_tokens[pos + 1].id == RBRACE;
+		const size_t param = findTypeParam(m_tokens[pos]);
+		if (!tree.findObject(args[i]) && plainParam && param < bound.size() && !bound[param])
+			bound[param] = TypeContainer::instance().getNumericType(ObjectInByte::DWORD, true);
+	}
+	for (size_t i = 0; i < bound.size(); i++)
+	{
+		if (!bound[i])
+			Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, std::format("cannot deduce {} of {}", m_typeParams[i].getName(), m_name.getName()));
+	}
+	return bound;
+}
+
+std::string GenericFunction::getInstanceName(const std::vector<Type*>& types) const
+{
+	std::string name = std::format("{}<", m_name.getName());
+	for (size_t i = 0; i < types.size(); i++)
+		name += std::format("{}{}", i ? "," : "", types[i]->getIdentifier().getName());
+	return name + ">";
+}
+
+std::vector<GenericToken> GenericFunction::instantiate(const std::string& instanceName, const std::vector<Type*>& types) const
+{
+	std::vector<GenericToken> tokens;
+	if (m_attributes & Function::MULTIVERSION)
+		tokens.push_back({ MULTIVERSION_KEYWORD });
+	if (m_attributes & Function::EXPORT)
+		tokens.push_back({ EXPORT_KEYWORD });
+	if (m_attributes & Function::FASTMATH)
+		tokens.push_back({ FASTMATH_KEYWORD });
+	if (m_attributes & Function::SPECIALIZE)
+		tokens.push_back({ SPECIALIZE_KEYWORD });
+	if (m_attributes & Function::CONSTEVAL)
+		tokens.push_back({ CONST_KEYWORD });
+	tokens.push_back({ FUNCTION_KEYWORD });
+	tokens.push_back({ IDENTIFIER, instanceName });
+	for (const GenericToken& token : m_tokens)
+	{
+		const size_t param = findTypeParam(token);
+		if (param < types.size())
+		{
+			GenericToken bound{ TYPE_NAME };
+			bound.type = types[param];
+			tokens.push_back(bound);
+		}
+		else
+			tokens.push_back(token);
+	}
+	return tokens;
+}
+
+void GenericFunctions::declare(Identifier name, std::vector<Identifier>&& typeParams, std::vector<GenericToken>&& tokens, uint32_t attributes)
+{
+	std::string key(name.getName());
+	if (m_templates.count(key) || AstTree::instance().findFunction(name))
+		Error(MessageEngine::Code::WRONG_ARGUMENT, name.getName());
+	m_templates.emplace(key, std::make_unique<GenericFunction>(name, std::move(typeParams), std::move(tokens), attributes));
+}
+
+Identifier GenericFunctions::getInstance(const Identifier& name, const std::vector<Identifier>& args)
+{
+	GenericFunction* gf = m_templates.at(std::string(name.getName())).get();
+	std::vector<Type*> types = gf->deduceTypes(args);
+	std::string instanceName = gf->getInstanceName(types);
+	if (m_instances.emplace(instanceName, gf).second)
+	{
+		m_pending.push_back(gf->instantiate(instanceName, types));
+		Info(MessageEngine::Code::GENERIC_INSTANCE, instanceName);
+	}
+	return Identifier(instanceName);
+}
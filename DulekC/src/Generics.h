@@ -0,0 +1,80 @@
+#pragma once
+#include "DuObject.h"
+#include "Type.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A token as the lexer produced it; `text` holds identifiers, float and string literals, `num`
+// numbers and array ranks, `bytetype` the builtin type keywords and `type` a bound type parameter.
+struct GenericToken
+{
+	int id;
+	std::string text = "";
+	uint64_t num = 0;
+	ObjectInByte bytetype = ObjectInByte::BOOLEAN;
+	Type* type = nullptr;
+};
+
+// `fnc name<T, ...>(args) -> R (types) { body }`. The lexer records the declaration after the
+// type parameters instead of handing it to the parser; each distinct tuple of argument types
+// replays it as an ordinary function named `name<type, ...>` with the parameters bound, so
+// every instance is parsed, typed and compiled like hand-written code.
+class GenericFunction
+{
+	Identifier m_name;
+	std::vector<Identifier> m_typeParams;
+	std::vector<GenericToken> m_tokens;
+	std::vector<size_t> m_paramTypes;
+	uint32_t m_attributes;
+
+	size_t findTypeParam(const GenericToken& token) const;
+	size_t deduce(size_t pos, Type* type, std::vector<Type*>& bound) const;
+public:
+	GenericFunction(Identifier name, std::vector<Identifier>&& typeParams, std::vector<GenericToken>&& tokens, uint32_t attributes);
+	const Identifier& getName() const
+	{
+		return m_name;
+	}
+	// Binds every type parameter from the call's arguments: variables by their type, a literal
+	// as i32 like any literal argument, for a parameter declared plainly as `T`.
+	std::vector<Type*> deduceTypes(const std::vector<Identifier>& args) const;
+	std::string getInstanceName(const std::vector<Type*>& types) const;
+	std::vector<GenericToken> instantiate(const std::string& instanceName, const std::vector<Type*>& types) const;
+};
+
+// Templates by name and the specialization table of their instances. An instance is created
+// once per type tuple and shared by every call site in the module; its declaration waits in a
+// queue until the lexer is back between global statements.
+class GenericFunctions
+{
+	std::unordered_map<std::string, std::unique_ptr<GenericFunction>> m_templates;
+	std::unordered_map<std::string, GenericFunction*> m_instances;
+	std::deque<std::vector<GenericToken>> m_pending;
+public:
+	void declare(Identifier name, std::vector<Identifier>&& typeParams, std::vector<GenericToken>&& tokens, uint32_t attributes);
+	bool isGeneric(const Identifier& name) const
+	{
+		return m_templates.count(std::string(name.getName()));
+	}
+	// Name of the instance the call `name(args)` binds to, creating it on first use.
+	Identifier getInstance(const Identifier& name, const std::vector<Identifier>& args);
+	bool hasPending() const
+	{
+		return !m_pending.empty();
+	}
+	std::vector<GenericToken> takePending()
+	{
+		std::vector<GenericToken> tokens = std::move(m_pending.front());
+		m_pending.pop_front();
+		return tokens;
+	}
+	static GenericFunctions& instance()
+	{
+		static GenericFunctions _gf;
+		return _gf;
+	}
+};
@@ -29,15 +29,24 @@ llvm::Value* LlvmBuilder::loadValue(llvm::IRBuilder<>& b, Variable* var)
 }
 
 
-llvm::Value* LlvmBuilder::allocate(llvm::IRBuilder<>& b, llvm::Value* sizeofElement, llvm::Value* counts, llvm::FunctionCallee* allocateFunc)
+llvm::Value* LlvmBuilder::allocate(llvm::IRBuilder<>& b, llvm::Value* sizeofElement, llvm::Value* counts, llvm::FunctionCallee* allocateFunc, uint64_t alignment)
 {
 	assert(sizeofElement->getType()->isIntegerTy() && counts->getType()->isIntegerTy());
 	sizeofElement = b.CreateIntCast(sizeofElement, llvm::Type::getInt64Ty(b.getContext()), false);
 	counts = b.CreateIntCast(counts, llvm::Type::getInt64Ty(b.getContext()), false);
 	llvm::Value* size = b.CreateMul(counts, sizeofElement, "CalculateSizeToAllocate");
-	std::vector<llvm::Value*> args(1);
-	args[0] = size;
-	llvm::Value* memory = b.CreateCall(*allocateFunc, args);
+	return allocateBytes(b, size, allocateFunc, alignment, 0);
+}
+
+// With an alignment, `allocateFunc` is DuAllocateAligned and `offset` bytes past the returned
+// pointer are aligned; the call site carries the alignment when that is the pointer itself.
+llvm::Value* LlvmBuilder::allocateBytes(llvm::IRBuilder<>& b, llvm::Value* size, llvm::FunctionCallee* allocateFunc, uint64_t alignment, uint64_t offset)
+{
+	if (!alignment)
+		return b.CreateCall(*allocateFunc, { size });
+	llvm::CallInst* memory = b.CreateCall(*allocateFunc, { size, b.getInt64(alignment), b.getInt64(offset) });
+	if (!offset)
+		memory->addRetAttr(llvm::Attribute::getWithAlignment(b.getContext(), llvm::Align(alignment)));
 	return memory;
 }
 
@@ -58,4 +67,130 @@ llvm::Value* LlvmBuilder::arrayOperator(llvm::IRBuilder<>& b, llvm::Value* addre
 {	
 	address_based = b.CreateInBoundsGEP(type, address_based, { dim }, "CREATE_IN_BOUNDS_GEP");
 	return address_based;
-}
\ No newline at end of file
+}
+
+// Fills an arrayN descriptor; the stride of a dimension is the product of the extents after it.
+llvm::Value* LlvmBuilder::makeArray(llvm::IRBuilder<>& b, llvm::Type* arrayType, llvm::Value* data, const std::vector<llvm::Value*>& extents)
+{
+	const unsigned rank = static_cast<unsigned>(extents.size());
+	llvm::Value* array = llvm::UndefValue::get(arrayType);
+	array = b.CreateInsertValue(array, b.CreateBitCast(data, arrayType->getStructElementType(ArrayType::DATA)), { ArrayType::DATA });
+	llvm::Value* stride = extents[rank - 1];
+	for (unsigned i = rank - 1; i > 0; i--)
+	{
+		array = b.CreateInsertValue(array, extents[i], { ArrayType::EXTENTS, i });
+		array = b.CreateInsertValue(array, stride, { ArrayType::STRIDES, i - 1 });
+		stride = b.CreateNUWMul(stride, extents[i - 1]);
+	}
+	return b.CreateInsertValue(array, extents[0], { ArrayType::EXTENTS, 0u });
+}
+
+void LlvmBuilder::flattenArray(llvm::IRBuilder<>& b, llvm::Value* array, unsigned rank, std::vector<llvm::Value*>& out)
+{
+	out.push_back(b.CreateExtractValue(array, { ArrayType::DATA }));
+	for (unsigned i = 0; i < rank; i++)
+		out.push_back(b.CreateExtractValue(array, { ArrayType::EXTENTS, i }));
+	for (unsigned i = 0; i + 1 < rank; i++)
+		out.push_back(b.CreateExtractValue(array, { ArrayType::STRIDES, i }));
+}
+
+llvm::Value* LlvmBuilder::unflattenArray(llvm::IRBuilder<>& b, llvm::Type* arrayType, llvm::Function::arg_iterator& arg, unsigned rank)
+{
+	llvm::Value* array = b.CreateInsertValue(llvm::UndefValue::get(arrayType), &*arg++, { ArrayType::DATA });
+	for (unsigned i = 0; i < rank; i++)
+		array = b.CreateInsertValue(array, &*arg++, { ArrayType::EXTENTS, i });
+	for (unsigned i = 0; i + 1 < rank; i++)
+		array = b.CreateInsertValue(array, &*arg++, { ArrayType::STRIDES, i });
+	return array;
+}
+
+// Row-major addressing folded into one GEP: the innermost index is added unscaled, so a loop
+// over the last dimension is a unit-stride access the vectorizer recognizes.
+llvm::Value* LlvmBuilder::arrayElement(llvm::IRBuilder<>& b, llvm::Value* array, llvm::Type* type, const std::vector<llvm::Value*>& indexes)
+{
+	const unsigned rank = static_cast<unsigned>(indexes.size());
+	llvm::Value* offset = indexes[rank - 1];
+	for (unsigned i = 0; i + 1 < rank; i++)
+	{
+		llvm::Value* stride = b.CreateExtractValue(array, { ArrayType::STRIDES, i }, "stride");
+		offset = b.CreateNSWAdd(b.CreateNSWMul(indexes[i], stride), offset);
+	}
+	llvm::Value* data = b.CreateExtractValue(array, { ArrayType::DATA }, "data");
+	return b.CreateInBoundsGEP(type, data, { offset }, "CREATE_IN_BOUNDS_GEP");
+}
+
+void LlvmBuilder::copyMemory(llvm::IRBuilder<>& b, llvm::Value* dst, llvm::Value* src, llvm::Type* type, llvm::Value* counts, bool overlapping)
+{
+	const llvm::Align align = b.GetInsertBlock()->getModule()->getDataLayout().getABITypeAlign(type);
+	counts = b.CreateIntCast(counts, b.getInt64Ty(), false);
+	llvm::Value* size = b.CreateMul(counts, llvm::ConstantExpr::getSizeOf(type), "CalculateSizeToCopy");
+	if (overlapping)
+		b.CreateMemMove(dst, align, src, align, size);
+	else
+		b.CreateMemCpy(dst, align, src, align, size);
+}
+
+// Byte-splat values become llvm.memset; anything else, and every non-temporal fill, is a
+// canonical store loop the vectorizer can widen.
+void LlvmBuilder::fillMemory(llvm::IRBuilder<>& b, llvm::Value* dst, llvm::Value* value, llvm::Type* type, llvm::Value* counts, bool nonTemporal)
+{
+	const llvm::DataLayout& dl = b.GetInsertBlock()->getModule()->getDataLayout();
+	const llvm::Align align = dl.getABITypeAlign(type);
+	counts = b.CreateIntCast(counts, b.getInt64Ty(), false);
+	if (type->isIntegerTy() && value->getType()->isIntegerTy())
+		value = b.CreateIntCast(value, type, true);
+	if (!nonTemporal && type->isIntegerTy())
+	{
+		llvm::Value* byte = nullptr;
+		auto* constant = llvm::dyn_cast<llvm::ConstantInt>(value);
+		const unsigned bits = type->getIntegerBitWidth();
+		if (bits == 8)
+			byte = value;
+		else if (constant && bits % 8 == 0 && constant->getValue() == llvm::APInt::getSplat(bits, constant->getValue().trunc(8)))
+			byte = b.getInt8(static_cast<uint8_t>(constant->getZExtValue()));
+		if (byte)
+		{
+			llvm::Value* size = b.CreateMul(counts, llvm::ConstantExpr::getSizeOf(type), "CalculateSizeToFill");
+			b.CreateMemSet(dst, byte, size, align);
+			return;
+		}
+	}
+
+	llvm::LLVMContext& context = b.getContext();
+	llvm::BasicBlock* preheader = b.GetInsertBlock();
+	llvm::Function* fn = preheader->getParent();
+	llvm::BasicBlock* body = llvm::BasicBlock::Create(context, "fill_body", fn);
+	llvm::BasicBlock* merge = llvm::BasicBlock::Create(context, "fill_merge", fn);
+	b.CreateCondBr(b.CreateICmpNE(counts, b.getInt64(0)), body, merge);
+
+	b.SetInsertPoint(body);
+	llvm::PHINode* index = b.CreatePHI(b.getInt64Ty(), 2, "fill_index");
+	index->addIncoming(b.getInt64(0), preheader);
+	llvm::StoreInst* store = b.CreateAlignedStore(value, arrayOperator(b, dst, index, type), align);
+	if (nonTemporal)
+		store->setMetadata(llvm::LLVMContext::MD_nontemporal, llvm::MDNode::get(context, llvm::ConstantAsMetadata::get(b.getInt32(1))));
+	llvm::Value* next = b.CreateAdd(index, b.getInt64(1), "fill_next", true, true);
+	index->addIncoming(next, body);
+	llvm::BranchInst* br = b.CreateCondBr(b.CreateICmpULT(next, counts), body, merge);
+	llvm::MDNode* loopId = llvm::MDNode::getDistinct(context, { nullptr, llvm::MDNode::get(context, llvm::MDString::get(context, "llvm.loop.mustprogress")) });
+	loopId->replaceOperandWith(0, loopId);
+	br->setMetadata(llvm::LLVMContext::MD_loop, loopId);
+	b.SetInsertPoint(merge);
+}
+
+// Fills a soa<R> descriptor; `fields` lists (descriptor element, field type) in block order, and
+// each field array starts right after the previous one's `counts` elements.
+llvm::Value* LlvmBuilder::makeSoa(llvm::IRBuilder<>& b, llvm::Type* soaType, llvm::Value* data, llvm::Value* counts, const std::vector<std::pair<unsigned, llvm::Type*>>& fields)
+{
+	llvm::Value* soa = llvm::UndefValue::get(soaType);
+	llvm::Value* bytes = b.CreateBitCast(data, b.getInt8PtrTy());
+	llvm::Value* offset = b.getInt64(0);
+	counts = b.CreateIntCast(counts, b.getInt64Ty(), false);
+	for (const auto& [element, type] : fields)
+	{
+		llvm::Value* field = b.CreateInBoundsGEP(b.getInt8Ty(), bytes, offset, "soa_field");
+		soa = b.CreateInsertValue(soa, b.CreateBitCast(field, type->getPointerTo()), { element });
+		offset = b.CreateNUWAdd(offset, b.CreateNUWMul(counts, b.CreateIntCast(llvm::ConstantExpr::getSizeOf(type), b.getInt64Ty(), false)));
+	}
+	return soa;
+}
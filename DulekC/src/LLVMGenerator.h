@@ -8,16 +8,15 @@
 #include <exception>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/IR/GlobalVariable.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
-#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/Support/TargetSelect.h>
 #include <algorithm>
 #include <ranges>
 #include "Statement.h"
-#include <llvm/ExecutionEngine/GenericValue.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/FileSystem.h>
 #include "SystemFunctions.h"
@@ -25,6 +24,20 @@
 #include "LLvmBuilder.h"
 #include "Interfaces.h"
 #include <llvm/IR/Verifier.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "DuFunctions.h"
+#include "TargetEmitter.h"
+#include "CallSiteSpecialization.h"
+#include "ConstEvaluation.h"
+#include "EscapeAnalysis.h"
+#include "FunctionAttributeInference.h"
+#include "TieredJIT.h"
+#include "ProfileGuidedOptimization.h"
 #define NO_CLEAR_MEMORY
 extern void not_implemented_feature();
 
@@ -33,12 +46,12 @@ extern void not_implemented_feature();
 class LLVMGen final
 {
 
+	llvm::orc::ThreadSafeContext m_context;
 	std::unique_ptr<llvm::Module> m_module;
 	llvm::IRBuilder<> m_builder;
 	llvm::LLVMContext& getContext()
 	{
-		static llvm::LLVMContext s_context;
-		return s_context;
+		return *m_context.getContext();
 	}
 	void generateMemoryForFunction(Scope* scope)
 	{
@@ -66,6 +79,27 @@ class LLVMGen final
 			}
 		}
 	}
+	// A global declared `align(N)` is padded up to a multiple of N, so a hot counter shares its
+	// cache line with no other global. The padding makes it a { T, [pad x i8] } struct; readers
+	// take the address of field 0.
+	llvm::GlobalVariable* createGlobal(Variable* v, llvm::Constant* init)
+	{
+		llvm::Type* type = v->getType()->getLLVMType(getContext());
+		const uint64_t alignment = v->getAlligment().value();
+		const uint64_t size = v->getType()->getSizeInBytes();
+		if (v->hasExplicitAlignment() && size % alignment)
+		{
+			llvm::Type* padding = llvm::ArrayType::get(llvm::Type::getInt8Ty(getContext()), alignment - size % alignment);
+			llvm::StructType* padded = llvm::StructType::get(type, padding);
+			if (init)
+				init = llvm::ConstantStruct::get(padded, { init, llvm::ConstantAggregateZero::get(padding) });
+			type = padded;
+		}
+		auto* global = new llvm::GlobalVariable(*m_module, type, false, llvm::GlobalValue::ExternalLinkage, init, v->getIdentifier().getName().data());
+		global->setAlignment(v->getAlligment());
+		return global;
+	}
+
 	void genIRForVariable(Variable* v, Scope* scope)
 	{
 		assert(v);
@@ -75,7 +109,7 @@ class LLVMGen final
 		{
 			llvm::Value* value = v->getLLVMValue(type);
 			llvm::Constant* _const = llvm::dyn_cast<llvm::Constant>(value);
-			llvm::GlobalVariable* global = new llvm::GlobalVariable(*m_module, type, false, llvm::GlobalValue::ExternalLinkage, _const, v->getIdentifier().getName().data());
+			createGlobal(v, _const);
 		}
 		else if(!v->isGlobalVariable() && ( scope->isFunction() || dynamic_cast<ISelfGeneratedScope*>(scope)))
 		{
@@ -157,12 +191,121 @@ class LLVMGen final
 
 		m_module->print(OS, nullptr);
 	}
+
+	// Only exported functions keep external linkage and the C calling convention; everything else
+	// becomes internal fastcc so the optimizer may inline, specialize and drop it.
+	void internalizeModule(const AstTree::Iterator begin, const AstTree::Iterator end)
+	{
+		for (auto it = begin; it != end; it++)
+		{
+			if (!(*it)->isFunction())
+				continue;
+			Function* fn = static_cast<Function*>(*it);
+			llvm::Function* llvmFn = m_module->getFunction(fn->getIdentifier().getName());
+			if (fn->isSystemFunction() || fn->isExported() || !llvmFn || llvmFn->isDeclaration())
+				continue;
+			llvmFn->setLinkage(llvm::GlobalValue::InternalLinkage);
+			llvmFn->setCallingConv(llvm::CallingConv::Fast);
+			for (llvm::User* user : llvmFn->users())
+			{
+				if (auto* call = llvm::dyn_cast<llvm::CallBase>(user))
+					call->setCallingConv(llvm::CallingConv::Fast);
+			}
+		}
+		for (llvm::GlobalVariable& gv : m_module->globals())
+		{
+			if (!gv.isDeclaration())
+				gv.setLinkage(llvm::GlobalValue::InternalLinkage);
+		}
+	}
+
+	void finalizeModule(const AstTree::Iterator begin, const AstTree::Iterator end)
+	{
+		ConstEvaluation::run(*m_module, m_context, [this](llvm::orc::LLJIT& jit) { return registerRuntimeSymbols(jit); });
+		internalizeModule(begin, end);
+		CallSiteSpecialization::run(*m_module);
+		EscapeAnalysis::run(*m_module);
+		FunctionAttributeInference::run(*m_module);
+	}
+
+	void declareGlobalVariables(Scope* global)
+	{
+		for (auto it : global->getList())
+		{
+			if (!it->isVariable())
+				continue;
+			createGlobal(static_cast<Variable*>(it), nullptr);
+		}
+	}
+
+	// Moves a module built in a worker context into this generator's context and links it in.
+	bool linkModule(llvm::orc::ThreadSafeModule unit)
+	{
+		llvm::SmallVector<char, 0> buffer;
+		unit.withModuleDo([&buffer](llvm::Module& m)
+			{
+				llvm::raw_svector_ostream OS(buffer);
+				llvm::WriteBitcodeToFile(m, OS);
+			});
+		auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(buffer.data(), buffer.size()), "du_unit"), getContext());
+		if (!parsed)
+		{
+			llvm::errs() << "error reading unit: " << llvm::toString(parsed.takeError()) << "\n";
+			return false;
+		}
+		return !llvm::Linker::linkModules(*m_module, std::move(*parsed));
+	}
+
+	// Runtime from DuFunctions is bound by address, so the JIT never searches the process for it.
+	llvm::Error registerRuntimeSymbols(llvm::orc::LLJIT& jit)
+	{
+		const auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+		llvm::orc::SymbolMap symbols;
+		symbols[jit.mangleAndIntern("DuDisplayNumber")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuDisplayNumber), flags);
+		symbols[jit.mangleAndIntern("DuDisplayFloat")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuDisplayFloat), flags);
+		symbols[jit.mangleAndIntern("DuPrintText")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuPrintText), flags);
+		symbols[jit.mangleAndIntern("DuPrintNumber")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuPrintNumber), flags);
+		symbols[jit.mangleAndIntern("DuPrintUnsigned")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuPrintUnsigned), flags);
+		symbols[jit.mangleAndIntern("DuPrintFloat")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuPrintFloat), flags);
+		symbols[jit.mangleAndIntern("DuAllocate")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuAllocate), flags);
+		symbols[jit.mangleAndIntern("DuAllocateAligned")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuAllocateAligned), flags);
+		symbols[jit.mangleAndIntern("DuDeallocate")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuDeallocate), flags);
+		symbols[jit.mangleAndIntern("DuWriteProfile")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuWriteProfile), flags);
+		symbols[jit.mangleAndIntern("DuBoundsCheckFailed")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&DuBoundsCheckFailed), flags);
+		return jit.getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)));
+	}
+
+	void runMain(llvm::JITTargetAddress address, llvm::Type* retType)
+	{
+		if (retType->isVoidTy())
+		{
+			using MainFn = void(*)();
+			llvm::jitTargetAddressToFunction<MainFn>(address)();
+		}
+		else if (retType->isIntegerTy(64))
+		{
+			using MainFn = int64_t(*)();
+			llvm::jitTargetAddressToFunction<MainFn>(address)();
+		}
+		else
+		{
+			using MainFn = int32_t(*)();
+			llvm::jitTargetAddressToFunction<MainFn>(address)();
+		}
+	}
 public:
-	LLVMGen(const std::string& modulename) : m_builder(getContext())
+	// The module carries the target triple and DataLayout from the start, so sizes folded while
+	// finalizing (escape analysis, memory intrinsics, parameter alignments) match the real layout.
+	LLVMGen(const std::string& modulename) : m_context(std::make_unique<llvm::LLVMContext>()), m_builder(getContext())
 	{
+		static std::once_flag s_targetInit;
+		std::call_once(s_targetInit, []()
+			{
+				llvm::InitializeNativeTarget();
+				llvm::InitializeNativeTargetAsmPrinter();
+			});
 		m_module = std::make_unique<llvm::Module>(modulename, getContext());
-		llvm::InitializeNativeTarget();
-		llvm::InitializeNativeTargetAsmPrinter();
+		TargetEmitter().prepareModule(*m_module);
 	}
 
 
@@ -172,30 +315,213 @@ public:
 		{ 
 			genIRForScope(*it);
 		}
+		finalizeModule(begin, end);
 	}
-	void executeCodeToByteCode()
+
+	// Every user function is lowered by a worker into its own context and module; calls to other
+	// functions and globals stay declarations until the units are linked back in source order,
+	// so the result does not depend on the number of jobs.
+	void genIRForFileParallel(const AstTree::Iterator begin, const AstTree::Iterator end, unsigned jobs)
 	{
+		std::vector<Scope*> functions;
+		Scope* global = nullptr;
+		for (auto it = begin; it != end; it++)
+		{
+			if (AstTree::instance().isGlobal(*it))
+				global = *it;
+			else if ((*it)->isFunction() && !static_cast<Function*>(*it)->isSystemFunction())
+				functions.push_back(*it);
+		}
+		if (global)
+			genIRForScope(global);
+
+		std::vector<llvm::orc::ThreadSafeModule> units(functions.size());
+		std::atomic<size_t> next = 0;
+		auto worker = [&]()
+			{
+				for (size_t i = next++; i < functions.size(); i = next++)
+				{
+					Variable::WorkerScope globals;
+					LLVMGen unit(functions[i]->getIdentifier().getName().data());
+					if (global)
+						unit.declareGlobalVariables(global);
+					unit.genIRForScope(functions[i]);
+					units[i] = unit.takeModule();
+				}
+			};
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < std::max(jobs, 1u); i++)
+			threads.emplace_back(worker);
+		worker();
+		for (auto& it : threads)
+			it.join();
+
+		for (auto& it : units)
+		{
+			if (!linkModule(std::move(it)))
+				llvm::errs() << "error linking function unit\n";
+		}
+		finalizeModule(begin, end);
+	}
+
+	llvm::orc::ThreadSafeModule takeModule()
+	{
+		SystemFunctions::ReleaseSystemFunctions(m_module.get());
+		return llvm::orc::ThreadSafeModule(std::move(m_module), m_context);
+	}
+	void applyProfile(const CodeGenOptions& options)
+	{
+		if (!options.profileUse.empty())
+			ProfileGuidedOptimization::apply(*m_module, options.profileUse);
+		if (!options.profileGenerate.empty())
+			ProfileGuidedOptimization::instrument(*m_module, options.profileGenerate);
+	}
+
+	void executeCodeToByteCode(const CodeGenOptions& options = CodeGenOptions())
+	{
+		applyProfile(options);
 		genfile();
-		std::string ErrStr;
 		llvm::verifyModule(*m_module, &llvm::errs());
 		llvm::Function* F = m_module->getFunction("main");
 		if (!F)
 		{
 			llvm::errs() << "cannot find fun.\n";
+			return;
+		}
+		llvm::Type* retType = F->getReturnType();
+		CodeGenOptions jitOptions = options;
+		if (jitOptions.cpu.empty())
+			jitOptions.cpu = "native";
+		TargetEmitter emitter(jitOptions);
+		emitter.prepareModule(*m_module);
+		auto jtmb = emitter.createJITTargetMachineBuilder();
+		if (!jtmb)
+		{
+			llvm::errs() << "error host target: " << llvm::toString(jtmb.takeError()) << "\n";
+			return;
 		}
 
-		std::unique_ptr<llvm::ExecutionEngine> EE(
-			llvm::EngineBuilder(std::move(m_module))
-			.setErrorStr(&ErrStr)
-			.create());
-
-		if (!EE)
+		const bool tiered = options.tierThreshold;
+		const bool precompiled = !tiered && options.splitParts;
+		std::unique_ptr<CompiledCodeCache> jitCache;
+		std::unique_ptr<llvm::orc::LLJIT> jit;
+		std::unique_ptr<TieredJIT> tiers;
+		if (tiered)
+		{
+			llvm::orc::LLJITBuilder builder;
+			builder.setJITTargetMachineBuilder(*jtmb);
+			builder.setCompileFunctionCreator([](llvm::orc::JITTargetMachineBuilder jtmb)
+				-> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>>
+				{
+					return std::make_unique<TieredJIT::TierCompiler>(std::move(jtmb));
+				});
+			auto created = builder.create();
+			if (!created)
+			{
+				llvm::errs() << "error LLJIT: " << llvm::toString(created.takeError()) << "\n";
+				return;
+			}
+			jit = std::move(*created);
+		}
+		else if (precompiled)
 		{
-			llvm::errs() << "error ExecutionEngine: " << ErrStr << "\n";
+			auto created = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(*jtmb).create();
+			if (!created)
+			{
+				llvm::errs() << "error LLJIT: " << llvm::toString(created.takeError()) << "\n";
+				return;
+			}
+			jit = std::move(*created);
 		}
-		
-		std::vector<llvm::GenericValue> Args;
-		llvm::GenericValue gv = EE->runFunction(F, Args);
+		else
+		{
+			llvm::orc::LLLazyJITBuilder builder;
+			builder.setJITTargetMachineBuilder(*jtmb);
+			if (!options.cacheDirectory.empty())
+			{
+				const std::string settings = std::format("{};{};{};O{};jit", jtmb->getTargetTriple().str(), jtmb->getCPU(), jtmb->getFeatures().getString(), options.optLevel);
+				jitCache = std::make_unique<CompiledCodeCache>(options.cacheDirectory, settings, options.cacheSizeLimit);
+				builder.setCompileFunctionCreator([cache = jitCache.get()](llvm::orc::JITTargetMachineBuilder jtmb)
+					-> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>>
+					{
+						return std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(jtmb), cache);
+					});
+			}
+			auto created = builder.create();
+			if (!created)
+			{
+				llvm::errs() << "error LLLazyJIT: " << llvm::toString(created.takeError()) << "\n";
+				return;
+			}
+			jit = std::move(*created);
+		}
+		if (auto err = registerRuntimeSymbols(*jit))
+		{
+			llvm::errs() << "error runtime symbols: " << llvm::toString(std::move(err)) << "\n";
+			return;
+		}
+		if (tiered)
+		{
+			tiers = std::make_unique<TieredJIT>(*jit, *jtmb, options.tierThreshold);
+			if (auto err = tiers->addModule(takeModule()))
+			{
+				llvm::errs() << "error module: " << llvm::toString(std::move(err)) << "\n";
+				return;
+			}
+		}
+		else if (precompiled)
+		{
+			for (auto& it : emitter.compileObjects(*m_module))
+			{
+				if (!it)
+					return;
+				if (auto err = jit->addObjectFile(std::move(it)))
+				{
+					llvm::errs() << "error object: " << llvm::toString(std::move(err)) << "\n";
+					return;
+				}
+			}
+		}
+		else
+		{
+			emitter.optimize(*m_module);
+			if (auto err = static_cast<llvm::orc::LLLazyJIT*>(jit.get())->addLazyIRModule(takeModule()))
+			{
+				llvm::errs() << "error module: " << llvm::toString(std::move(err)) << "\n";
+				return;
+			}
+		}
+		auto mainSym = jit->lookup("main");
+		if (!mainSym)
+		{
+			llvm::errs() << "error lookup main: " << llvm::toString(mainSym.takeError()) << "\n";
+			return;
+		}
+		runMain(mainSym->getAddress(), retType);
+		if (!options.profileGenerate.empty())
+		{
+			auto writerSym = jit->lookup(ProfileGuidedOptimization::s_writer);
+			if (writerSym)
+				llvm::jitTargetAddressToFunction<void(*)()>(writerSym->getAddress())();
+			else
+				llvm::errs() << "error lookup profile writer: " << llvm::toString(writerSym.takeError()) << "\n";
+		}
+		if (tiers)
+		{
+			tiers->finish();
+			tiers->reportStatistics();
+		}
+		emitter.reportCacheStatistics();
+		if (jitCache)
+			Info(MessageEngine::Code::CACHE_STATISTICS, std::format("hits: {} misses: {}", jitCache->getHits(), jitCache->getMisses()));
+	}
+	bool emit(EmitMode mode, const std::string& baseName, const CodeGenOptions& options = CodeGenOptions())
+	{
+		applyProfile(options);
+		if (llvm::verifyModule(*m_module, &llvm::errs()))
+			return false;
+		TargetEmitter emitter(options);
+		return emitter.emit(*m_module, mode, baseName);
 	}
 	void print()
 	{
@@ -205,6 +531,9 @@ public:
 
 	~LLVMGen()
 	{
+		if (m_module)
+			SystemFunctions::ReleaseSystemFunctions(m_module.get());
+		Type::releaseLLVMTypes();
 	}
 
 };
\ No newline at end of file
@@ -2,12 +2,21 @@
 #include "Variable.h"
 #include <llvm/IR/IRBuilder.h>
 #include "Type.h"
+#include <vector>
 class LlvmBuilder
 {
 public:
 	static Variable* assigmentValue(llvm::IRBuilder<>& b, Variable* l, llvm::Value* r);
 	static llvm::Value* loadValue(llvm::IRBuilder<>& b, Variable* var);
-	static llvm::Value* allocate(llvm::IRBuilder<>& b, llvm::Value* sizeofElement, llvm::Value* counts, llvm::FunctionCallee*);
+	static llvm::Value* allocate(llvm::IRBuilder<>& b, llvm::Value* sizeofElement, llvm::Value* counts, llvm::FunctionCallee*, uint64_t alignment = 0);
+	static llvm::Value* allocateBytes(llvm::IRBuilder<>& b, llvm::Value* size, llvm::FunctionCallee* allocateFunc, uint64_t alignment, uint64_t offset);
 	static llvm::Value* deallocate(llvm::IRBuilder<>& b, llvm::Value* Pointer, llvm::FunctionCallee* deallocateFunc);
+	static void copyMemory(llvm::IRBuilder<>& b, llvm::Value* dst, llvm::Value* src, llvm::Type* type, llvm::Value* counts, bool overlapping);
+	static void fillMemory(llvm::IRBuilder<>& b, llvm::Value* dst, llvm::Value* value, llvm::Type* type, llvm::Value* counts, bool nonTemporal);
 	static llvm::Value* arrayOperator(llvm::IRBuilder<>& b, llvm::Value* address_based, llvm::Value* dim, llvm::Type* type);
+	static llvm::Value* makeArray(llvm::IRBuilder<>& b, llvm::Type* arrayType, llvm::Value* data, const std::vector<llvm::Value*>& extents);
+	static void flattenArray(llvm::IRBuilder<>& b, llvm::Value* array, unsigned rank, std::vector<llvm::Value*>& out);
+	static llvm::Value* unflattenArray(llvm::IRBuilder<>& b, llvm::Type* arrayType, llvm::Function::arg_iterator& arg, unsigned rank);
+	static llvm::Value* makeSoa(llvm::IRBuilder<>& b, llvm::Type* soaType, llvm::Value* data, llvm::Value* counts, const std::vector<std::pair<unsigned, llvm::Type*>>& fields);
+	static llvm::Value* arrayElement(llvm::IRBuilder<>& b, llvm::Value* array, llvm::Type* type, const std::vector<llvm::Value*>& indexes);
 };
@@ -16,6 +16,7 @@ public:
 		IF,
 		ELSE,
 		WHILE,
+		FOR,
 		END_CONTEXT
 	};
 private:
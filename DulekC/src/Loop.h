@@ -55,10 +55,10 @@ protected:
 	}
 
 
-	void createMergeBlock(llvm::IRBuilder<>& b)
+	void createMergeBlock(llvm::IRBuilder<>& b, const char* name = "while_merge")
 	{
 		if (!m_mergeBlock)
-			m_mergeBlock = llvm::BasicBlock::Create(b.getContext(), "while_merge", m_llvmFun);
+			m_mergeBlock = llvm::BasicBlock::Create(b.getContext(), name, m_llvmFun);
 	}
 	virtual void callCallback(std::function<void(Scope*, DuObject*)> cb, Scope* scope)
 	{
@@ -144,4 +144,85 @@ public:
 		}
 		b.SetInsertPoint(merge);
 	}
-};
\ No newline at end of file
+};
+
+
+// `for i -> T : begin .. end step k { }` is lowered in rotated canonical form: the preheader
+// guards the first iteration, the induction variable is a PHI in the body header and the latch
+// holds the increment and the exit compare, so LoopVectorize and LoopUnroll see a countable loop.
+// The PHI is spilled to the variable's alloca for the body; writes to it do not alter the trip count.
+// With a step above 1 the latch tests the distance left, `end - i > step`, instead of `i + step < end`,
+// so the increment never wraps near the type's maximum and stays nsw/nuw. The parser rejects a
+// step below 1.
+class ForScope final : public Loop
+{
+	Variable* m_induction;
+	Expression* m_begin;
+	Expression* m_end;
+	uint64_t m_step;
+
+	bool isSigned() const
+	{
+		auto* numeric = dynamic_cast<SimpleNumericType*>(m_induction->getType());
+		return !numeric || numeric->isSigned();
+	}
+	llvm::Value* getBound(llvm::IRBuilder<>& b, llvm::Module* m, Expression* expr, llvm::Type* type)
+	{
+		expr->processExpression(m, b, b.getContext(), false);
+		llvm::Value* val = LlvmBuilder::loadValue(b, expr->getRes());
+		return b.CreateIntCast(val, type, isSigned(), "for_bound");
+	}
+	llvm::Value* createExitCompare(llvm::IRBuilder<>& b, llvm::Value* iv, llvm::Value* end)
+	{
+		return isSigned() ? b.CreateICmpSLT(iv, end, "for_cond") : b.CreateICmpULT(iv, end, "for_cond");
+	}
+	llvm::MDNode* createLoopMetadata(llvm::LLVMContext& context)
+	{
+		llvm::Metadata* mustProgress = llvm::MDNode::get(context, llvm::MDString::get(context, "llvm.loop.mustprogress"));
+		llvm::MDNode* loopId = llvm::MDNode::getDistinct(context, { nullptr, mustProgress });
+		loopId->replaceOperandWith(0, loopId);
+		return loopId;
+	}
+public:
+	ForScope(Variable* induction, Expression* begin, Expression* end, uint64_t step) : Loop("FOR_SCOPE", nullptr), m_induction(induction), m_begin(begin), m_end(end), m_step(step)
+	{
+		assert(static_cast<int64_t>(step) > 0);
+	}
+	virtual void callCallback(std::function<void(Scope*, DuObject*)> cb, Scope* scope) override
+	{
+		Loop::callCallback([this, cb](Scope* s, DuObject* obj) { if (obj != m_induction) cb(s, obj); }, scope);
+	}
+	virtual void generateLLVM(llvm::IRBuilder<>& b, llvm::Module* m, std::function<void(Scope*, DuObject*)> cb) override
+	{
+		Loop::generateLLVM(b, m, cb);
+		llvm::Type* type = m_induction->getLLVMType(b.getContext());
+		m_induction->setAlloca(b.CreateAlloca(type, nullptr, m_induction->getIdentifier().getName()));
+		llvm::Value* begin = getBound(b, m, m_begin, type);
+		llvm::Value* end = getBound(b, m, m_end, type);
+		llvm::BasicBlock* preheader = b.GetInsertBlock();
+
+		createMergeBlock(b, "for_merge");
+		llvm::BasicBlock* merge = getMergeBlock();
+		llvm::BasicBlock* body = getBasicBlock(b.getContext(), m_llvmFun);
+		b.CreateCondBr(createExitCompare(b, begin, end), body, merge);
+
+		b.SetInsertPoint(body);
+		llvm::PHINode* iv = b.CreatePHI(type, 2, m_induction->getIdentifier().getName());
+		iv->addIncoming(begin, preheader);
+		b.CreateStore(iv, m_induction->getAlloca());
+		callCallback(cb, this);
+		if (!m_hasRet)
+		{
+			llvm::BasicBlock* latch = llvm::BasicBlock::Create(b.getContext(), "for_latch", m_llvmFun);
+			b.CreateBr(latch);
+			b.SetInsertPoint(latch);
+			llvm::Constant* step = llvm::ConstantInt::get(type, m_step);
+			llvm::Value* next = b.CreateAdd(iv, step, "for_next", !isSigned(), isSigned());
+			iv->addIncoming(next, latch);
+			llvm::Value* cond = m_step == 1 ? createExitCompare(b, next, end) : b.CreateICmpUGT(b.CreateSub(end, iv, "for_left"), step, "for_cond");
+			llvm::BranchInst* br = b.CreateCondBr(cond, body, merge);
+			br->setMetadata(llvm::LLVMContext::MD_loop, createLoopMetadata(b.getContext()));
+		}
+		b.SetInsertPoint(merge);
+	}
+};
@@ -31,6 +31,15 @@ public:
 		WRONG_ARGUMENT,
 		CANNOT_OPEN_FILE,
 		CANNOT_CREATE_RVAL_EXPR_LSIDE,
+		CACHE_STATISTICS,
+		TIER_STATISTICS,
+		PROFILE_MISMATCH,
+		RECORD_LAYOUT,
+		RecordInsideScope,
+		GENERIC_INSTANCE,
+		SPECIALIZATION,
+		CONST_EVALUATION,
+		CONST_EVALUATION_FAILED,
 	};
 private:
 	std::string getErrorMessage(Code code)
@@ -62,6 +71,24 @@ private:
 			return "This file cannot be open:";
 		case Code::CANNOT_CREATE_RVAL_EXPR_LSIDE:
 			return "Cannot create this expr on Left side:";
+		case Code::CACHE_STATISTICS:
+			return "Compiled code cache";
+		case Code::TIER_STATISTICS:
+			return "Tiered JIT";
+		case Code::PROFILE_MISMATCH:
+			return "Profile does not match the program, ignored:";
+		case Code::RECORD_LAYOUT:
+			return "Record layout";
+		case Code::RecordInsideScope:
+			return "Cannot declare record in scope";
+		case Code::GENERIC_INSTANCE:
+			return "Generic instance";
+		case Code::SPECIALIZATION:
+			return "Specialized call sites";
+		case Code::CONST_EVALUATION:
+			return "Evaluated at compile time";
+		case Code::CONST_EVALUATION_FAILED:
+			return "Cannot evaluate at compile time";
 		default:
 			return "Not implemented message";
 		}
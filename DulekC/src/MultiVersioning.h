@@ -0,0 +1,130 @@
+#pragma once
+#include <llvm/ADT/Triple.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <string>
+#include <vector>
+
+// Functions declared as `multiversion fnc` are cloned for every x86-64 feature level. The original
+// symbol becomes a thunk calling through a pointer that a module constructor fills from
+// DuCpuFeatureLevel(), so the choice is made once when the program is loaded.
+class MultiVersioning final
+{
+public:
+	static constexpr const char* s_attribute = "du-multiversion";
+
+	enum class Level : int32_t
+	{
+		BASELINE = 0,
+		AVX2,
+		AVX512,
+		LAST
+	};
+
+private:
+	static const char* getSuffix(Level level)
+	{
+		switch (level)
+		{
+		case Level::AVX2:
+			return ".avx2";
+		case Level::AVX512:
+			return ".avx512";
+		case Level::BASELINE:
+		default:
+			return ".baseline";
+		}
+	}
+
+	static void setTarget(llvm::Function* fn, Level level)
+	{
+		switch (level)
+		{
+		case Level::AVX2:
+			fn->addFnAttr("target-cpu", "haswell");
+			fn->addFnAttr("target-features", "+avx,+avx2,+fma,+bmi,+bmi2");
+			break;
+		case Level::AVX512:
+			fn->addFnAttr("target-cpu", "skylake-avx512");
+			fn->addFnAttr("target-features", "+avx,+avx2,+fma,+bmi,+bmi2,+avx512f,+avx512bw,+avx512dq,+avx512vl");
+			break;
+		case Level::BASELINE:
+		default:
+			break;
+		}
+	}
+
+	static llvm::GlobalVariable* generateVersions(llvm::Module& m, llvm::Function* fn, std::vector<llvm::Function*>& versions)
+	{
+		for (int32_t i = 0; i < static_cast<int32_t>(Level::LAST); i++)
+		{
+			llvm::ValueToValueMapTy vmap;
+			llvm::Function* clone = llvm::CloneFunction(fn, vmap);
+			clone->setName(fn->getName() + getSuffix(static_cast<Level>(i)));
+			clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+			clone->removeFnAttr(s_attribute);
+			setTarget(clone, static_cast<Level>(i));
+			versions.push_back(clone);
+		}
+		llvm::PointerType* ptrType = fn->getType();
+		auto* impl = new llvm::GlobalVariable(m, ptrType, false, llvm::GlobalValue::InternalLinkage, llvm::ConstantPointerNull::get(ptrType), fn->getName() + ".impl");
+
+		const llvm::GlobalValue::LinkageTypes linkage = fn->getLinkage();
+		fn->deleteBody();
+		fn->setLinkage(linkage);
+		fn->removeFnAttr(s_attribute);
+		// The thunk reads the mutable `.impl` pointer, so inferred memory attributes no longer hold
+		fn->removeFnAttr(llvm::Attribute::ReadNone);
+		fn->removeFnAttr(llvm::Attribute::ReadOnly);
+		llvm::IRBuilder<> b(llvm::BasicBlock::Create(m.getContext(), "dispatch", fn));
+		std::vector<llvm::Value*> args;
+		for (auto& it : fn->args())
+			args.push_back(&it);
+		llvm::Value* target = b.CreateLoad(ptrType, impl);
+		llvm::CallInst* call = b.CreateCall(fn->getFunctionType(), target, args);
+		call->setCallingConv(fn->getCallingConv());
+		call->setTailCall();
+		if (fn->getReturnType()->isVoidTy())
+			b.CreateRetVoid();
+		else
+			b.CreateRet(call);
+		return impl;
+	}
+
+public:
+	static void run(llvm::Module& m)
+	{
+		if (llvm::Triple(m.getTargetTriple()).getArch() != llvm::Triple::x86_64)
+			return;
+		std::vector<llvm::Function*> marked;
+		for (llvm::Function& fn : m)
+		{
+			if (!fn.isDeclaration() && fn.hasFnAttribute(s_attribute))
+				marked.push_back(&fn);
+		}
+		if (marked.empty())
+			return;
+
+		llvm::IRBuilder<> b(m.getContext());
+		llvm::FunctionCallee featureLevel = m.getOrInsertFunction("DuCpuFeatureLevel", b.getInt32Ty());
+		llvm::Function* init = llvm::Function::Create(llvm::FunctionType::get(b.getVoidTy(), false), llvm::GlobalValue::InternalLinkage, "du.multiversion.init", m);
+		b.SetInsertPoint(llvm::BasicBlock::Create(m.getContext(), "entry", init));
+		llvm::Value* level = b.CreateCall(featureLevel);
+		for (llvm::Function* fn : marked)
+		{
+			std::vector<llvm::Function*> versions;
+			llvm::GlobalVariable* impl = generateVersions(m, fn, versions);
+			llvm::Value* selected = versions[static_cast<int32_t>(Level::BASELINE)];
+			for (int32_t i = 1; i < static_cast<int32_t>(Level::LAST); i++)
+			{
+				llvm::Value* supported = b.CreateICmpSGE(level, b.getInt32(i));
+				selected = b.CreateSelect(supported, versions[i], selected);
+			}
+			b.CreateStore(selected, impl);
+		}
+		b.CreateRetVoid();
+		llvm::appendToGlobalCtors(m, init, 0);
+	}
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ProfileSummary.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/ProfileCommon.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/xxhash.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "MessageEngine.h"
+extern void Warning(MessageEngine::Code code, std::string_view additionalMsg);
+
+// Counter based PGO for Du programs. Every function gets an entry counter and every conditional
+// branch (if, while, for) a pair of counters: how often it ran and how often it was taken. The
+// counters are addressed by position (functions sorted by name), so -profile-use must see the same IR as -profile-generate;
+// a hash of the function names and branch counts guards against stale profiles.
+class ProfileGuidedOptimization final
+{
+public:
+	static constexpr const char* s_writer = "du.profile.write";
+
+private:
+	static constexpr const char* s_counters = "du.profile.counters";
+
+	static std::vector<llvm::Function*> getFunctions(llvm::Module& m)
+	{
+		std::vector<llvm::Function*> functions;
+		for (llvm::Function& fn : m)
+		{
+			if (!fn.isDeclaration() && !fn.getName().startswith("du."))
+				functions.push_back(&fn);
+		}
+		std::sort(functions.begin(), functions.end(), [](llvm::Function* l, llvm::Function* r) { return l->getName() < r->getName(); });
+		return functions;
+	}
+
+	static std::vector<llvm::BranchInst*> getBranches(llvm::Function& fn)
+	{
+		std::vector<llvm::BranchInst*> branches;
+		for (llvm::BasicBlock& bb : fn)
+		{
+			auto* br = llvm::dyn_cast<llvm::BranchInst>(bb.getTerminator());
+			if (br && br->isConditional())
+				branches.push_back(br);
+		}
+		return branches;
+	}
+
+	static uint64_t getLayoutHash(const std::vector<llvm::Function*>& functions, uint64_t& count)
+	{
+		std::string layout;
+		count = 0;
+		for (llvm::Function* fn : functions)
+		{
+			const size_t branches = getBranches(*fn).size();
+			layout += std::format("{}:{};", fn->getName().str(), branches);
+			count += 1 + 2 * branches;
+		}
+		return llvm::xxHash64(layout);
+	}
+
+	static void increment(llvm::IRBuilder<>& b, llvm::GlobalVariable* counters, uint64_t index, llvm::Value* step)
+	{
+		llvm::Value* ptr = b.CreateConstInBoundsGEP2_64(counters->getValueType(), counters, 0, index);
+		b.CreateStore(b.CreateAdd(b.CreateLoad(b.getInt64Ty(), ptr), step), ptr);
+	}
+
+	static std::optional<std::vector<uint64_t>> readProfile(const std::string& path, uint64_t hash, uint64_t count)
+	{
+		auto buffer = llvm::MemoryBuffer::getFile(path);
+		if (!buffer)
+		{
+			Warning(MessageEngine::Code::CANNOT_OPEN_FILE, path);
+			return std::nullopt;
+		}
+		std::istringstream in((*buffer)->getBuffer().str());
+		std::string magic;
+		uint64_t fileHash = 0, fileCount = 0;
+		in >> magic >> fileHash >> fileCount;
+		if (magic != "du-profile" || fileHash != hash || fileCount != count)
+		{
+			Warning(MessageEngine::Code::PROFILE_MISMATCH, path);
+			return std::nullopt;
+		}
+		std::vector<uint64_t> counts(count);
+		for (uint64_t& it : counts)
+			in >> it;
+		if (!in)
+		{
+			Warning(MessageEngine::Code::PROFILE_MISMATCH, path);
+			return std::nullopt;
+		}
+		return counts;
+	}
+
+	static void setBranchWeights(llvm::BranchInst* br, uint64_t taken, uint64_t notTaken)
+	{
+		const uint64_t max = std::max(taken, notTaken);
+		const uint64_t scale = max / std::numeric_limits<uint32_t>::max() + 1;
+		llvm::MDBuilder md(br->getContext());
+		br->setMetadata(llvm::LLVMContext::MD_prof, md.createBranchWeights(static_cast<uint32_t>(taken / scale), static_cast<uint32_t>(notTaken / scale)));
+	}
+
+public:
+	// Adds the counters and a `du.profile.write` function that dumps them to `path`. AOT builds
+	// run it as a module destructor; the JIT calls it after main returns. Every function now
+	// writes memory, directly or through its callees, so inferred readnone/readonly is dropped.
+	static void instrument(llvm::Module& m, const std::string& path)
+	{
+		for (llvm::Function& fn : m)
+		{
+			if (fn.isIntrinsic())
+				continue;
+			fn.removeFnAttr(llvm::Attribute::ReadNone);
+			fn.removeFnAttr(llvm::Attribute::ReadOnly);
+		}
+		std::vector<llvm::Function*> functions = getFunctions(m);
+		uint64_t count = 0;
+		const uint64_t hash = getLayoutHash(functions, count);
+		llvm::IRBuilder<> b(m.getContext());
+		llvm::ArrayType* arrayType = llvm::ArrayType::get(b.getInt64Ty(), count);
+		auto* counters = new llvm::GlobalVariable(m, arrayType, false, llvm::GlobalValue::InternalLinkage, llvm::ConstantAggregateZero::get(arrayType), s_counters);
+
+		uint64_t index = 0;
+		for (llvm::Function* fn : functions)
+		{
+			std::vector<llvm::BranchInst*> branches = getBranches(*fn);
+			llvm::BasicBlock::iterator entry = fn->getEntryBlock().getFirstInsertionPt();
+			while (llvm::isa<llvm::AllocaInst>(*entry))
+				entry++;
+			b.SetInsertPoint(&*entry);
+			increment(b, counters, index++, b.getInt64(1));
+			for (llvm::BranchInst* br : branches)
+			{
+				b.SetInsertPoint(br);
+				increment(b, counters, index++, b.getInt64(1));
+				increment(b, counters, index++, b.CreateZExt(br->getCondition(), b.getInt64Ty()));
+			}
+		}
+
+		llvm::FunctionCallee writeProfile = m.getOrInsertFunction("DuWriteProfile", b.getVoidTy(), b.getInt8PtrTy(), b.getInt64Ty(), b.getInt64Ty()->getPointerTo(), b.getInt64Ty());
+		llvm::Function* writer = llvm::Function::Create(llvm::FunctionType::get(b.getVoidTy(), false), llvm::GlobalValue::ExternalLinkage, s_writer, m);
+		b.SetInsertPoint(llvm::BasicBlock::Create(m.getContext(), "entry", writer));
+		llvm::Value* data = b.CreateConstInBoundsGEP2_64(arrayType, counters, 0, 0);
+		b.CreateCall(writeProfile, { b.CreateGlobalStringPtr(path, "du.profile.path"), b.getInt64(hash), data, b.getInt64(count) });
+		b.CreateRetVoid();
+		llvm::appendToGlobalDtors(m, writer, 0);
+	}
+
+	// Turns the counters from `path` into branch weights, function entry counts, a module profile
+	// summary, hot/cold function attributes and section prefixes, and orders functions hottest first.
+	static bool apply(llvm::Module& m, const std::string& path)
+	{
+		std::vector<llvm::Function*> functions = getFunctions(m);
+		uint64_t count = 0;
+		const uint64_t hash = getLayoutHash(functions, count);
+		auto counts = readProfile(path, hash, count);
+		if (!counts)
+			return false;
+
+		llvm::InstrProfSummaryBuilder summary(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+		std::vector<uint64_t> entries;
+		uint64_t index = 0;
+		for (llvm::Function* fn : functions)
+		{
+			std::vector<uint64_t> record;
+			const uint64_t entry = (*counts)[index++];
+			fn->setEntryCount(llvm::Function::ProfileCount(entry, llvm::Function::PCT_Real));
+			entries.push_back(entry);
+			record.push_back(entry);
+			for (llvm::BranchInst* br : getBranches(*fn))
+			{
+				const uint64_t executed = (*counts)[index++];
+				const uint64_t taken = std::min((*counts)[index++], executed);
+				if (executed)
+					setBranchWeights(br, taken, executed - taken);
+				record.push_back(taken);
+				record.push_back(executed - taken);
+			}
+			summary.addRecord(llvm::InstrProfRecord(std::move(record)));
+		}
+		std::unique_ptr<llvm::ProfileSummary> ps = summary.getSummary();
+		m.setProfileSummary(ps->getMD(m.getContext()), llvm::ProfileSummary::PSK_Instr);
+
+		const uint64_t hotThreshold = llvm::ProfileSummaryBuilder::getHotCountThreshold(ps->getDetailedSummary());
+		for (size_t i = 0; i < functions.size(); i++)
+		{
+			if (!entries[i])
+			{
+				functions[i]->addFnAttr(llvm::Attribute::Cold);
+				functions[i]->setSectionPrefix("unlikely");
+			}
+			else if (entries[i] >= hotThreshold)
+			{
+				functions[i]->addFnAttr(llvm::Attribute::Hot);
+				functions[i]->setSectionPrefix("hot");
+			}
+		}
+
+		std::vector<size_t> order(functions.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&entries](size_t l, size_t r) { return entries[l] > entries[r]; });
+		for (size_t i : order)
+		{
+			functions[i]->removeFromParent();
+			m.getFunctionList().push_back(functions[i]);
+		}
+		return true;
+	}
+};
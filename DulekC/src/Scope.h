@@ -185,26 +185,47 @@ protected:
 	llvm::Function* m_llvmFunction;
 	bool m_isSystemFunction;
 	bool m_isProcedure;
-	llvm::FunctionType* getFunctionType(llvm::LLVMContext& context)
+	uint32_t m_attributes = 0;
+	std::vector<bool> m_restrictArgs;
+	static inline bool s_fastMath = false;
+	// arrayN and slice arguments are flattened, data pointer first, so the pointer itself can
+	// carry noalias and alignment attributes.
+	llvm::FunctionType* createFunctionType(llvm::LLVMContext& context) const
 	{
-		if (!m_llvmType)
+		if (m_args.empty())
+			return llvm::FunctionType::get(getLLVMType(context), false);
+		std::vector<llvm::Type*> types;
+		for (auto it : m_typesArgs)
 		{
-			if(m_args.empty())
-				m_llvmType = llvm::FunctionType::get(getLLVMType(context), false);
-			else
+			if (ArrayType* at = dynamic_cast<ArrayType*>(it))
 			{
-				std::vector<llvm::Type*> types;
-				for (auto it : m_typesArgs)
-				{
-					types.push_back(it->getLLVMType(context));
-				}
-				m_llvmType = llvm::FunctionType::get(getLLVMType(context), types, false);
+				types.push_back(at->getElementType()->getLLVMType(context)->getPointerTo());
+				types.insert(types.end(), at->getFieldCount() - 1, llvm::Type::getInt64Ty(context));
 			}
+			else
+				types.push_back(it->getLLVMType(context));
 		}
+		return llvm::FunctionType::get(getLLVMType(context), types, false);
+	}
+	void addParameterAttributes(llvm::Function* fn) const;
+	void setFastMath(llvm::Function* fn, llvm::IRBuilder<>& b) const;
+	llvm::FunctionType* getFunctionType(llvm::LLVMContext& context)
+	{
+		if (!m_llvmType || &m_llvmType->getContext() != &context)
+			m_llvmType = createFunctionType(context);
 		return m_llvmType;
 	}
 
 public:
+	enum Attribute : uint32_t
+	{
+		NONE = 0,
+		MULTIVERSION = 1 << 0,
+		EXPORT = 1 << 1,
+		FASTMATH = 1 << 2,
+		SPECIALIZE = 1 << 3,
+		CONSTEVAL = 1 << 4,
+	};
 	Function(Identifier id, Type* returnType, std::vector<Identifier>&& args, std::vector<Type*>&& types, bool systemFunction, bool isProcedure) : Scope(id), m_args(std::move(args)), m_typesArgs(std::move(types)), m_returnType(returnType), m_llvmType(nullptr), m_llvmFunction(nullptr), m_isSystemFunction(systemFunction), m_isProcedure(isProcedure)
 	{
 		if (m_args.size() == m_typesArgs.size())
@@ -234,6 +255,7 @@ public:
 		return nullptr;
 	}
 	llvm::Function* getLLVMFunction(llvm::LLVMContext& context, llvm::Module* m, llvm::IRBuilder<>& b);
+	llvm::FunctionCallee getLLVMCallee(llvm::LLVMContext& context, llvm::Module* m) const;
 	Type* getType() const
 	{
 		return m_returnType;
@@ -242,6 +264,28 @@ public:
 	{
 		m_isSystemFunction = flag;
 	}
+	void setAttributes(uint32_t attributes)
+	{
+		m_attributes = attributes;
+	}
+	void setRestrictArguments(std::vector<bool>&& restrictArgs)
+	{
+		m_restrictArgs = std::move(restrictArgs);
+		for (size_t i = 0; i < m_restrictArgs.size() && i < m_typesArgs.size(); i++)
+		{
+			if (m_restrictArgs[i] && !dynamic_cast<PointerType*>(m_typesArgs[i]) && !dynamic_cast<ArrayType*>(m_typesArgs[i]))
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, m_args[i].getName());
+		}
+	}
+	bool isRestrictArgument(size_t i) const
+	{
+		return i < m_restrictArgs.size() && m_restrictArgs[i];
+	}
+	const bool hasAttribute(Attribute attribute) const { return m_attributes & attribute; }
+	// -fastmath makes every function `fastmath`.
+	static void enableFastMath() { s_fastMath = true; }
+	const bool isFastMath() const { return s_fastMath || hasAttribute(FASTMATH); }
+	const bool isExported() const { return hasAttribute(EXPORT) || getIdentifier() == Identifier("main"); }
 	const bool isSystemFunction() const { return m_isSystemFunction;  }
 	const bool isProcedure() const { return m_isProcedure;  }
 	virtual bool isFunction() const { return true; }
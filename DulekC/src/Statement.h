@@ -48,7 +48,9 @@ class AssigmentStatement : public Statement
 				if (right && right->getIdentifier().getName().empty())
 				{
 					auto value = right->loadValue();
-					if (value->isNumericValue())
+					if (left->getType()->isFloatingPointType() || dynamic_cast<VectorType*>(left->getType()))
+						m_left = LlvmBuilder::assigmentValue(builder, left, value->getLLVMValue(left->getLLVMType(context)));
+					else if (value->isNumericValue())
 					{
 						llvm::Constant* c = llvm::ConstantInt::get(left->getLLVMType(context), static_cast<NumericValue*>(value)->loadValue());
 						m_left = LlvmBuilder::assigmentValue(builder, left, c);
@@ -66,10 +68,17 @@ class AssigmentStatement : public Statement
 					else
 					{
 						llvm::GlobalVariable* gv = module->getGlobalVariable(right->getIdentifier().getName());
-						val = builder.CreateLoad(gv->getValueType(), gv, "");
+						llvm::Type* valueType = gv->getValueType();
+						llvm::Value* address = gv;
+						if (valueType != m_right->getLLVMType(context))
+						{
+							address = builder.CreateStructGEP(valueType, gv, 0);
+							valueType = valueType->getStructElementType(0);
+						}
+						val = builder.CreateLoad(valueType, address, "");
 					}
 					if (m_right->getLLVMType(context) != m_left->getLLVMType(context)) {
-						val = left->getType()->convertValueBasedOnType(builder, val, right->getLLVMType(context), context);
+						val = left->getType()->convertValueBasedOnType(builder, val, right->getLLVMType(context), context, SimpleNumericType::isSignedSource(right->getType()));
 					}
 					m_left = LlvmBuilder::assigmentValue(builder, left, val);
 				}
@@ -94,17 +103,25 @@ class AssigmentStatement : public Statement
 				{
 					expr->processExpression(module, builder, context, static_cast<SimpleNumericType*>(left->getType())->isSigned());
 				}
-				else if (PointerType* pt = dynamic_cast<PointerType*>(left->getType()))
+				else if (dynamic_cast<PointerType*>(left->getType()) || dynamic_cast<ArrayType*>(left->getType()) || dynamic_cast<SoaType*>(left->getType()) || dynamic_cast<RecordType*>(left->getType()))
 				{
 					expr->processExpression(module, builder, context, false);
 				}
+				else if (left->getType()->isFloatingPointType())
+				{
+					expr->processExpression(module, builder, context, true);
+				}
+				else if (VectorType* vt = dynamic_cast<VectorType*>(left->getType()))
+				{
+					expr->processExpression(module, builder, context, vt->isSigned());
+				}
 				llvm::Value* val = nullptr;
 
 				if (expr->isExprValueWrapper())
 				{
-					if (ArrayOperatorExprerssion* aoe = dynamic_cast<ArrayOperatorExprerssion*>(expr))
+					if (expr->yieldsAddress())
 					{
-						DuObject* res = aoe->getResWrapper();
+						DuObject* res = expr->getResWrapper();
 						Variable* var = dynamic_cast<ValueWrapper*>(res)->generateVariableValAsAlloca(builder);
 						val = LlvmBuilder::loadValue(builder, var);
 						delete var;
@@ -117,11 +134,12 @@ class AssigmentStatement : public Statement
 
 				if (val->getType() != m_left->getLLVMType(context))
 				{
-					val = left->getType()->convertValueBasedOnType(builder, val, val->getType(), context);
+					Type* source = expr->isExprValueWrapper() ? expr->getResWrapper()->getType() : expr->getRes()->getType();
+					val = left->getType()->convertValueBasedOnType(builder, val, val->getType(), context, SimpleNumericType::isSignedSource(source));
 				}
 				m_left = LlvmBuilder::assigmentValue(builder, left, val);
 			}
-			else if (ArrayOperatorExprerssion* left = dynamic_cast<ArrayOperatorExprerssion*>(m_left))
+			else if (Expression* left = dynamic_cast<Expression*>(m_left); left && left->yieldsAddress())
 			{
 				left->processExpression(module, builder, context, false);
 				llvm::Value* lVal = nullptr;
@@ -141,16 +159,32 @@ class AssigmentStatement : public Statement
 					{
 						expr->processExpression(module, builder, context, static_cast<SimpleNumericType*>(varl->getType())->isSigned());
 					}
-					else if (PointerType* pt = dynamic_cast<PointerType*>(varl->getType()))
+					else if (dynamic_cast<PointerType*>(varl->getType()) || dynamic_cast<ArrayType*>(varl->getType()) || dynamic_cast<RecordType*>(varl->getType()))
 					{
 						expr->processExpression(module, builder, context, false);
 					}
-					if (expr->isExprValueWrapper())
+					else if (varl->getType()->isFloatingPointType())
+					{
+						expr->processExpression(module, builder, context, true);
+					}
+					else if (VectorType* vt = dynamic_cast<VectorType*>(varl->getType()))
+					{
+						expr->processExpression(module, builder, context, vt->isSigned());
+					}
+					Type* source = expr->isExprValueWrapper() ? expr->getResWrapper()->getType() : expr->getRes()->getType();
+					if (expr->yieldsAddress())
+					{
+						ValueWrapper* element = expr->getResWrapper();
+						val = builder.CreateLoad(element->getType()->getLLVMType(context), element->getValue());
+					}
+					else if (expr->isExprValueWrapper())
 					{
 						val = expr->getResWrapper()->getLLVMValue(nullptr);
 					}
 					else
 						val = LlvmBuilder::loadValue(builder, expr->getRes());
+					if (val->getType() != varl->getLLVMType(context) && (varl->getType()->isSimpleNumericType() || varl->getType()->isFloatingPointType() || dynamic_cast<VectorType*>(varl->getType())))
+						val = varl->getType()->convertValueBasedOnType(builder, val, val->getType(), context, SimpleNumericType::isSignedSource(source));
 					m_left = LlvmBuilder::assigmentValue(builder, varl, val);
 				}
 				
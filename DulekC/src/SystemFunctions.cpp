@@ -6,13 +6,28 @@ void SystemFunctions::generatePrintNumberFunction()
 {
 	llvm::FunctionType* printFunctionType = llvm::FunctionType::get(m_builder->getInt32Ty(), m_builder->getInt32Ty(), false);
 	auto functionPtr = llvm::Function::Create(printFunctionType, llvm::Function::LinkageTypes::ExternalLinkage, "DuDisplayNumber", m_module);
+	functionPtr->setDoesNotThrow();
 	auto printfFunc = llvm::FunctionCallee(functionPtr);
 	m_functions.insert({ getSysFunctionName(SysFunctionID::DISPLAY), printfFunc });
 }
+void SystemFunctions::generatePrintFloatFunction()
+{
+	llvm::FunctionType* printFunctionType = llvm::FunctionType::get(m_builder->getInt32Ty(), m_builder->getDoubleTy(), false);
+	auto functionPtr = llvm::Function::Create(printFunctionType, llvm::Function::LinkageTypes::ExternalLinkage, s_displayFloat, m_module);
+	functionPtr->setDoesNotThrow();
+	m_functions.insert({ s_displayFloat, llvm::FunctionCallee(functionPtr) });
+}
 void SystemFunctions::generateAllocateFunction()
 {
 	llvm::FunctionType* allocateFunctionType = llvm::FunctionType::get(m_builder->getInt8Ty()->getPointerTo(), m_builder->getInt64Ty(), false);
 	auto functionPtr = llvm::Function::Create(allocateFunctionType, llvm::Function::LinkageTypes::ExternalLinkage, "DuAllocate", m_module);
+	functionPtr->setDoesNotThrow();
+	// malloc semantics: a fresh block of arg0 bytes that aliases nothing else
+	functionPtr->addRetAttr(llvm::Attribute::NoAlias);
+	functionPtr->addRetAttr(llvm::Attribute::getWithAlignment(*m_context, llvm::Align(s_defaultAlignment)));
+	functionPtr->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(*m_context, 0, llvm::None));
+	functionPtr->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
+	functionPtr->setWillReturn();
 	auto allocateFunc = llvm::FunctionCallee(functionPtr);
 	m_functions.insert({ getSysFunctionName(SysFunctionID::ALLOCATE_MEMORY), allocateFunc });
 }
@@ -20,9 +35,54 @@ void SystemFunctions::generateDeallocateFunction()
 {
 	llvm::FunctionType* deallocateFunctionType = llvm::FunctionType::get(m_builder->getVoidTy(), m_builder->getInt8Ty()->getPointerTo(), false);
 	auto functionPtr = llvm::Function::Create(deallocateFunctionType, llvm::Function::LinkageTypes::ExternalLinkage, "DuDeallocate", m_module);
+	functionPtr->setDoesNotThrow();
+	functionPtr->addFnAttr(llvm::Attribute::InaccessibleMemOrArgMemOnly);
+	functionPtr->addParamAttr(0, llvm::Attribute::NoCapture);
+	functionPtr->setWillReturn();
 	auto allocateFunc = llvm::FunctionCallee(functionPtr);
 	m_functions.insert({ getSysFunctionName(SysFunctionID::DEALLOCATE_MEMORY), allocateFunc });
 }
+void SystemFunctions::generateAllocateAlignedFunction()
+{
+	llvm::Type* i64 = m_builder->getInt64Ty();
+	llvm::FunctionType* allocateFunctionType = llvm::FunctionType::get(m_builder->getInt8Ty()->getPointerTo(), { i64, i64, i64 }, false);
+	auto functionPtr = llvm::Function::Create(allocateFunctionType, llvm::Function::LinkageTypes::ExternalLinkage, s_allocateAligned, m_module);
+	functionPtr->setDoesNotThrow();
+	functionPtr->addRetAttr(llvm::Attribute::NoAlias);
+	functionPtr->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(*m_context, 0, llvm::None));
+	functionPtr->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
+	functionPtr->setWillReturn();
+	m_functions.insert({ s_allocateAligned, llvm::FunctionCallee(functionPtr) });
+}
+void SystemFunctions::generatePrintFunctions()
+{
+	auto create = [this](const char* name, std::vector<llvm::Type*> params) {
+		auto functionPtr = llvm::Function::Create(llvm::FunctionType::get(m_builder->getVoidTy(), params, false), llvm::Function::LinkageTypes::ExternalLinkage, name, m_module);
+		functionPtr->setDoesNotThrow();
+		m_functions.insert({ name, llvm::FunctionCallee(functionPtr) });
+		return functionPtr;
+	};
+	llvm::Function* printText = create(s_printText, { m_builder->getInt8Ty()->getPointerTo(), m_builder->getInt64Ty() });
+	printText->addParamAttr(0, llvm::Attribute::NoCapture);
+	printText->addParamAttr(0, llvm::Attribute::ReadOnly);
+	create(s_printNumber, { m_builder->getInt64Ty() });
+	create(s_printUnsigned, { m_builder->getInt64Ty() });
+	create(s_printFloat, { m_builder->getDoubleTy() });
+}
+
+llvm::Constant* SystemFunctions::getStringLiteral(const std::string& text)
+{
+	llvm::GlobalVariable*& literal = m_strings[text];
+	if (!literal)
+	{
+		llvm::Constant* bytes = llvm::ConstantDataArray::getString(*m_context, text, false);
+		literal = new llvm::GlobalVariable(*m_module, bytes->getType(), true, llvm::GlobalValue::PrivateLinkage, bytes, ".str");
+		literal->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+		literal->setAlignment(llvm::Align(1));
+	}
+	llvm::Constant* zero = m_builder->getInt64(0);
+	return llvm::ConstantExpr::getInBoundsGetElementPtr(literal->getValueType(), literal, llvm::ArrayRef<llvm::Constant*>{ zero, zero });
+}
 
 llvm::FunctionCallee* SystemFunctions::findFunction(Identifier id)
 {
@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <llvm/IR/IRBuilder.h>
 #include <map>
+#include <memory>
+#include <mutex>
 #include "DuObject.h"
 class SystemFunctions final
 {
@@ -9,26 +11,60 @@ class SystemFunctions final
 	llvm::IRBuilder<>* m_builder;
 	llvm::LLVMContext* m_context;
 	std::map<std::string, llvm::FunctionCallee> m_functions;
+	std::map<std::string, llvm::GlobalVariable*> m_strings;
+	static inline std::mutex s_lock;
+	static inline std::map<llvm::Module*, std::unique_ptr<SystemFunctions>> s_perModule;
 	void generatePrintNumberFunction();
+	void generatePrintFloatFunction();
 	void generateAllocateFunction();
 	void generateDeallocateFunction();
+	void generateAllocateAlignedFunction();
+	void generatePrintFunctions();
 	SystemFunctions(llvm::Module* m, llvm::IRBuilder<>* b, llvm::LLVMContext* c) : m_module(m), m_builder(b), m_context(c)
 	{
 		generatePrintNumberFunction();
+		generatePrintFloatFunction();
 		generateAllocateFunction();
 		generateDeallocateFunction();
+		generateAllocateAlignedFunction();
+		generatePrintFunctions();
 	}
 public:
+	// Runtime entry behind `new<N>`; not callable from Du code, so it has no `$` name.
+	static constexpr const char* s_allocateAligned = "DuAllocateAligned";
+	// `$display` of an f32 or f64 argument; f32 is widened to double.
+	static constexpr const char* s_displayFloat = "DuDisplayFloat";
+	// Runtime behind `$print`, one entry per kind of argument.
+	static constexpr const char* s_printText = "DuPrintText";
+	static constexpr const char* s_printNumber = "DuPrintNumber";
+	static constexpr const char* s_printUnsigned = "DuPrintUnsigned";
+	static constexpr const char* s_printFloat = "DuPrintFloat";
+	// Alignment DuAllocate guarantees; `new<N>` with N up to this needs no aligned allocation.
+	static constexpr uint64_t s_defaultAlignment = 16;
 	static SystemFunctions* GetSystemFunctions(llvm::Module* m, llvm::IRBuilder<>* b, llvm::LLVMContext* c)
 	{
-		static SystemFunctions sf(m, b, c);
-		return &sf;
+		std::lock_guard<std::mutex> guard(s_lock);
+		auto& sf = s_perModule[m];
+		if (!sf)
+			sf.reset(new SystemFunctions(m, b, c));
+		return sf.get();
+	}
+	// Called when the generator gives up `m`, so a later module at the same address never sees
+	// its declarations or builder.
+	static void ReleaseSystemFunctions(llvm::Module* m)
+	{
+		std::lock_guard<std::mutex> guard(s_lock);
+		s_perModule.erase(m);
 	}
 	enum class SysFunctionID : uint16_t
 	{
 		DISPLAY = 0,
 		ALLOCATE_MEMORY,
 		DEALLOCATE_MEMORY,
+		COPY_MEMORY,
+		FILL_MEMORY,
+		MOVE_MEMORY,
+		STREAM_STORE,
 		LAST
 	};
 	static std::string getSysFunctionName(SysFunctionID ID)
@@ -41,10 +77,34 @@ public:
 			return "$allocate";
 		case SysFunctionID::DEALLOCATE_MEMORY:
 			return "$deallocate";
+		case SysFunctionID::COPY_MEMORY:
+			return "$copy";
+		case SysFunctionID::FILL_MEMORY:
+			return "$fill";
+		case SysFunctionID::MOVE_MEMORY:
+			return "$move";
+		case SysFunctionID::STREAM_STORE:
+			return "$stream_store";
 		case SysFunctionID::LAST:
 		default:
 			return std::string();
 		}
 	}
+	static SysFunctionID getSysFunctionID(Identifier id)
+	{
+		for (uint16_t i = 0; i < static_cast<uint16_t>(SysFunctionID::LAST); i++)
+		{
+			if (id == Identifier(getSysFunctionName(static_cast<SysFunctionID>(i))))
+				return static_cast<SysFunctionID>(i);
+		}
+		return SysFunctionID::LAST;
+	}
+	// Bulk memory builtins have no runtime callee; they are lowered inline to memory intrinsics.
+	static bool isBulkMemoryFunction(SysFunctionID ID)
+	{
+		return ID == SysFunctionID::COPY_MEMORY || ID == SysFunctionID::FILL_MEMORY || ID == SysFunctionID::MOVE_MEMORY || ID == SysFunctionID::STREAM_STORE;
+	}
 	llvm::FunctionCallee* findFunction(Identifier id);
+	// i8* to the bytes of a string literal; equal literals share one private constant per module.
+	llvm::Constant* getStringLiteral(const std::string& text);
 };
@@ -0,0 +1,497 @@
+#pragma once
+#include <llvm/IR/Module.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Transforms/IPO/HotColdSplitting.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <atomic>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "BoundsCheck.h"
+#include "CompiledCodeCache.h"
+#include "MultiVersioning.h"
+#include "MessageEngine.h"
+extern void Info(MessageEngine::Code code, std::string_view additionalMsg);
+
+#ifndef DU_RUNTIME_LIB
+#ifdef _WIN32
+#define DU_RUNTIME_LIB "DuFunctionsStatic.lib"
+#else
+#define DU_RUNTIME_LIB "libDuFunctionsStatic.a"
+#endif
+#endif
+
+enum class EmitMode : uint8_t
+{
+	JIT = 0,
+	OBJ,
+	ASM,
+	BC,
+	LL,
+	EXE,
+};
+
+struct CodeGenOptions
+{
+	unsigned optLevel = 0;
+	unsigned splitParts = 0;
+	std::string cpu;
+	std::string cacheDirectory;
+	uint64_t cacheSizeLimit = 0;
+	uint64_t tierThreshold = 0;
+	std::string profileGenerate;
+	std::string profileUse;
+	std::string linker;
+};
+
+class TargetEmitter final
+{
+	std::unique_ptr<llvm::TargetMachine> m_targetMachine;
+	std::string m_triple;
+	CodeGenOptions m_options;
+	std::unique_ptr<CompiledCodeCache> m_cache;
+
+	std::unique_ptr<llvm::TargetMachine> createTargetMachine() const
+	{
+		std::string error;
+		const llvm::Target* target = llvm::TargetRegistry::lookupTarget(m_triple, error);
+		if (!target)
+		{
+			llvm::errs() << "cannot find target " << m_triple << ": " << error << "\n";
+			return nullptr;
+		}
+		llvm::TargetOptions opt;
+		return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(m_triple, getCPU(), getFeatures(), opt, llvm::Reloc::PIC_, llvm::None, getCodeGenOptLevel()));
+	}
+
+	llvm::CodeGenOpt::Level getCodeGenOptLevel() const
+	{
+		const llvm::CodeGenOpt::Level levels[] = { llvm::CodeGenOpt::None, llvm::CodeGenOpt::Less, llvm::CodeGenOpt::Default, llvm::CodeGenOpt::Aggressive };
+		return levels[std::min(m_options.optLevel, 3u)];
+	}
+
+	// "native" tunes for the host: its CPU name together with every feature it reports.
+	std::string getCPU() const
+	{
+		if (m_options.cpu.empty())
+			return "generic";
+		if (m_options.cpu == "native")
+			return llvm::sys::getHostCPUName().str();
+		return m_options.cpu;
+	}
+
+	std::string getFeatures() const
+	{
+		if (m_options.cpu != "native")
+			return "";
+		llvm::StringMap<bool> hostFeatures;
+		llvm::SubtargetFeatures features;
+		if (llvm::sys::getHostCPUFeatures(hostFeatures))
+		{
+			for (auto& it : hostFeatures)
+				features.AddFeature(it.first(), it.second);
+		}
+		return features.getString();
+	}
+
+	bool emitMachineCode(llvm::Module& m, llvm::TargetMachine& tm, llvm::raw_pwrite_stream& OS, llvm::CodeGenFileType type)
+	{
+		llvm::legacy::PassManager pm;
+		if (tm.addPassesToEmitFile(pm, OS, nullptr, type))
+		{
+			llvm::errs() << "target cannot emit this file type\n";
+			return false;
+		}
+		pm.run(m);
+		return true;
+	}
+
+	bool emitMachineCode(llvm::Module& m, const std::string& path, llvm::CodeGenFileType type)
+	{
+		std::error_code EC;
+		llvm::raw_fd_ostream OS(path, EC, llvm::sys::fs::OF_None);
+		if (EC)
+		{
+			llvm::errs() << "cannot open '" << path << "': " << EC.message() << "\n";
+			return false;
+		}
+		return emitMachineCode(m, *m_targetMachine, OS, type);
+	}
+
+	bool writeFile(const std::string& path, llvm::StringRef content)
+	{
+		std::error_code EC;
+		llvm::raw_fd_ostream OS(path, EC, llvm::sys::fs::OF_None);
+		if (EC)
+		{
+			llvm::errs() << "cannot open '" << path << "': " << EC.message() << "\n";
+			return false;
+		}
+		OS << content;
+		return true;
+	}
+
+	// -linker= wins; otherwise lld-link or MSVC link on Windows and the C compiler driver elsewhere.
+	llvm::ErrorOr<std::string> findLinker() const
+	{
+		if (!m_options.linker.empty())
+			return llvm::sys::findProgramByName(m_options.linker);
+#ifdef _WIN32
+		if (auto lld = llvm::sys::findProgramByName("lld-link"))
+			return lld;
+		return llvm::sys::findProgramByName("link");
+#else
+		return llvm::sys::findProgramByName("cc");
+#endif
+	}
+
+	static bool isMsvcLinker(llvm::StringRef path)
+	{
+		const std::string name = llvm::sys::path::stem(path).lower();
+		return name == "link" || name == "lld-link";
+	}
+
+	bool linkExecutable(const std::vector<std::string>& objects, const std::string& output)
+	{
+		auto linker = findLinker();
+		if (!linker)
+		{
+			llvm::errs() << "cannot find system linker: " << linker.getError().message() << "\n";
+			return false;
+		}
+		const std::string outputArg = "/OUT:" + output;
+		std::vector<llvm::StringRef> args = { *linker };
+		args.insert(args.end(), objects.begin(), objects.end());
+		if (isMsvcLinker(*linker))
+			args.insert(args.end(), { "/NOLOGO", DU_RUNTIME_LIB, outputArg });
+		else
+			args.insert(args.end(), { DU_RUNTIME_LIB, "-o", output });
+		std::string errMsg;
+		if (llvm::sys::ExecuteAndWait(*linker, args, llvm::None, {}, 0, 0, &errMsg) != 0)
+		{
+			llvm::errs() << "linking '" << output << "' failed " << errMsg << "\n";
+			return false;
+		}
+		return true;
+	}
+
+public:
+	TargetEmitter(const CodeGenOptions& options = CodeGenOptions()) : m_triple(llvm::sys::getDefaultTargetTriple()), m_options(options)
+	{
+		m_targetMachine = createTargetMachine();
+	}
+
+	static std::optional<EmitMode> parseEmitMode(std::string_view name)
+	{
+		if (name == "obj")
+			return EmitMode::OBJ;
+		if (name == "asm")
+			return EmitMode::ASM;
+		if (name == "bc")
+			return EmitMode::BC;
+		if (name == "ll")
+			return EmitMode::LL;
+		if (name == "exe")
+			return EmitMode::EXE;
+		return std::nullopt;
+	}
+
+	static const char* getExtension(EmitMode mode)
+	{
+		switch (mode)
+		{
+		case EmitMode::OBJ:
+#ifdef _WIN32
+			return ".obj";
+#else
+			return ".o";
+#endif
+		case EmitMode::ASM:
+			return ".s";
+		case EmitMode::BC:
+			return ".bc";
+		case EmitMode::LL:
+			return ".ll";
+		case EmitMode::EXE:
+#ifdef _WIN32
+			return ".exe";
+#else
+			return "";
+#endif
+		case EmitMode::JIT:
+		default:
+			return "";
+		}
+	}
+
+	llvm::Expected<llvm::orc::JITTargetMachineBuilder> createJITTargetMachineBuilder() const
+	{
+		llvm::orc::JITTargetMachineBuilder jtmb((llvm::Triple(m_triple)));
+		jtmb.setCPU(getCPU());
+		jtmb.addFeatures(llvm::SubtargetFeatures(getFeatures()).getFeatures());
+		jtmb.setCodeGenOptLevel(getCodeGenOptLevel());
+		return jtmb;
+	}
+
+	llvm::TargetMachine* getTargetMachine()
+	{
+		return m_targetMachine.get();
+	}
+
+	void prepareModule(llvm::Module& m)
+	{
+		m.setTargetTriple(m_triple);
+		if (m_targetMachine)
+			m.setDataLayout(m_targetMachine->createDataLayout());
+	}
+
+	static void optimize(llvm::Module& m, llvm::TargetMachine* tm, unsigned optLevel)
+	{
+		if (!optLevel)
+			return;
+		const llvm::OptimizationLevel levels[] = { llvm::OptimizationLevel::O0, llvm::OptimizationLevel::O1, llvm::OptimizationLevel::O2, llvm::OptimizationLevel::O3 };
+		llvm::LoopAnalysisManager lam;
+		llvm::FunctionAnalysisManager fam;
+		llvm::CGSCCAnalysisManager cgam;
+		llvm::ModuleAnalysisManager mam;
+		llvm::PassBuilder pb(tm);
+		pb.registerModuleAnalyses(mam);
+		pb.registerCGSCCAnalyses(cgam);
+		pb.registerFunctionAnalyses(fam);
+		pb.registerLoopAnalyses(lam);
+		pb.crossRegisterProxies(lam, fam, cgam, mam);
+		if (BoundsCheck::isEnabled())
+			BoundsCheck::registerPasses(pb);
+		llvm::ModulePassManager mpm = pb.buildPerModuleDefaultPipeline(levels[std::min(optLevel, 3u)]);
+		if (m.getProfileSummary(false))
+			mpm.addPass(llvm::HotColdSplittingPass());
+		mpm.run(m, mam);
+	}
+
+	void optimize(llvm::Module& m)
+	{
+		optimize(m, m_targetMachine.get(), m_options.optLevel);
+	}
+
+	// Optimizes (unless the parts come from an already optimized module) and compiles every
+	// bitcode part to an object on a pool of threads. Each part is re-read into a private context
+	// so the threads share nothing; objects keep the part order.
+	std::vector<std::unique_ptr<llvm::MemoryBuffer>> compileParts(const std::vector<llvm::SmallVector<char, 0>>& bitcode, bool optimizeParts = true)
+	{
+		std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(bitcode.size());
+		std::atomic<size_t> next = 0;
+		auto worker = [this, &bitcode, &objects, &next, optimizeParts]()
+			{
+				auto tm = createTargetMachine();
+				if (!tm)
+					return;
+				for (size_t i = next++; i < bitcode.size(); i = next++)
+				{
+					llvm::LLVMContext context;
+					auto part = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode[i].data(), bitcode[i].size()), "du_part"), context);
+					if (!part)
+					{
+						llvm::errs() << "error reading part: " << llvm::toString(part.takeError()) << "\n";
+						continue;
+					}
+					if (optimizeParts)
+						optimize(**part, tm.get(), m_options.optLevel);
+					llvm::SmallVector<char, 0> buffer;
+					llvm::raw_svector_ostream OS(buffer);
+					if (emitMachineCode(**part, *tm, OS, llvm::CGFT_ObjectFile))
+						objects[i] = llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(buffer.data(), buffer.size()), "du_part.o");
+				}
+			};
+		std::vector<std::thread> threads;
+		const size_t count = std::min<size_t>(bitcode.size(), std::max(std::thread::hardware_concurrency(), 1u));
+		for (size_t i = 1; i < count; i++)
+			threads.emplace_back(worker);
+		worker();
+		for (auto& it : threads)
+			it.join();
+		return objects;
+	}
+
+	// Splits the module along call-graph boundaries into parts compiled in parallel.
+	std::vector<std::unique_ptr<llvm::MemoryBuffer>> compileSplit(llvm::Module& m, unsigned parts)
+	{
+		prepareModule(m);
+		std::vector<llvm::SmallVector<char, 0>> bitcode;
+		llvm::SplitModule(m, std::max(parts, 1u), [&bitcode](std::unique_ptr<llvm::Module> part)
+			{
+				llvm::raw_svector_ostream OS(bitcode.emplace_back());
+				llvm::WriteBitcodeToFile(*part, OS);
+			});
+		return compileParts(bitcode);
+	}
+
+	// One part per defined function plus one holding the global variables. Local symbols are
+	// promoted to hidden externals so the parts still resolve against each other.
+	static std::vector<std::unique_ptr<llvm::Module>> partitionPerFunction(llvm::Module& m)
+	{
+		for (llvm::GlobalValue& gv : m.global_values())
+		{
+			if (gv.isDeclaration() || !gv.hasLocalLinkage())
+				continue;
+			if (!gv.hasName())
+				gv.setName("__du_anon");
+			gv.setLinkage(llvm::GlobalValue::ExternalLinkage);
+			gv.setVisibility(llvm::GlobalValue::HiddenVisibility);
+		}
+		std::vector<std::unique_ptr<llvm::Module>> parts;
+		for (llvm::Function& fn : m)
+		{
+			if (fn.isDeclaration())
+				continue;
+			llvm::ValueToValueMapTy vmap;
+			parts.push_back(llvm::CloneModule(m, vmap, [&fn](const llvm::GlobalValue* gv) { return gv == &fn; }));
+		}
+		if (!m.global_empty())
+		{
+			llvm::ValueToValueMapTy vmap;
+			parts.push_back(llvm::CloneModule(m, vmap, [](const llvm::GlobalValue* gv) { return llvm::isa<llvm::GlobalVariable>(gv); }));
+		}
+		return parts;
+	}
+
+	// Per-function compilation through the object cache. The whole module is optimized first, so
+	// inlining and IPO still see every function; only machine code generation is cached, and the
+	// keys cover the optimized IR, so a change that alters an inlined callee misses as it should.
+	std::vector<std::unique_ptr<llvm::MemoryBuffer>> compileCached(llvm::Module& m)
+	{
+		prepareModule(m);
+		optimize(m);
+		CompiledCodeCache* cache = getCache();
+		auto parts = partitionPerFunction(m);
+		std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(parts.size());
+		std::vector<std::string> keys;
+		std::vector<size_t> missing;
+		std::vector<llvm::SmallVector<char, 0>> bitcode;
+		for (size_t i = 0; i < parts.size(); i++)
+		{
+			keys.push_back(cache->getKey(*parts[i]));
+			objects[i] = cache->lookup(keys.back());
+			if (objects[i])
+				continue;
+			missing.push_back(i);
+			llvm::raw_svector_ostream OS(bitcode.emplace_back());
+			llvm::WriteBitcodeToFile(*parts[i], OS);
+		}
+		auto compiled = compileParts(bitcode, false);
+		for (size_t i = 0; i < missing.size(); i++)
+		{
+			if (compiled[i])
+				cache->store(keys[missing[i]], compiled[i]->getMemBufferRef());
+			objects[missing[i]] = std::move(compiled[i]);
+		}
+		return objects;
+	}
+
+	std::vector<std::unique_ptr<llvm::MemoryBuffer>> compileObjects(llvm::Module& m)
+	{
+		if (!m_options.cacheDirectory.empty())
+			return compileCached(m);
+		return compileSplit(m, m_options.splitParts);
+	}
+
+	std::string getCodeGenSettings() const
+	{
+		return std::format("{};{};{};O{}", m_triple, m_targetMachine->getTargetCPU().str(), m_targetMachine->getTargetFeatureString().str(), m_options.optLevel);
+	}
+
+	CompiledCodeCache* getCache()
+	{
+		if (!m_cache && !m_options.cacheDirectory.empty())
+			m_cache = std::make_unique<CompiledCodeCache>(m_options.cacheDirectory, getCodeGenSettings(), m_options.cacheSizeLimit);
+		return m_cache.get();
+	}
+
+	void reportCacheStatistics()
+	{
+		if (m_cache)
+			Info(MessageEngine::Code::CACHE_STATISTICS, std::format("hits: {} misses: {}", m_cache->getHits(), m_cache->getMisses()));
+	}
+
+	bool emitObjects(llvm::Module& m, EmitMode mode, const std::string& baseName)
+	{
+		auto objects = compileObjects(m);
+		reportCacheStatistics();
+		std::vector<std::string> paths;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (!objects[i])
+			{
+				llvm::errs() << "compiling part " << i << " failed\n";
+				return false;
+			}
+			paths.push_back(baseName + "." + std::to_string(i) + getExtension(EmitMode::OBJ));
+			if (!writeFile(paths.back(), objects[i]->getBuffer()))
+				return false;
+		}
+		if (mode == EmitMode::EXE)
+			return linkExecutable(paths, baseName + getExtension(mode));
+		return true;
+	}
+
+	bool emit(llvm::Module& m, EmitMode mode, const std::string& baseName)
+	{
+		if (!m_targetMachine)
+			return false;
+		prepareModule(m);
+		MultiVersioning::run(m);
+		if ((m_options.splitParts || !m_options.cacheDirectory.empty()) && (mode == EmitMode::OBJ || mode == EmitMode::EXE))
+			return emitObjects(m, mode, baseName);
+		optimize(m);
+		const std::string path = baseName + getExtension(mode);
+		switch (mode)
+		{
+		case EmitMode::OBJ:
+			return emitMachineCode(m, path, llvm::CGFT_ObjectFile);
+		case EmitMode::ASM:
+			return emitMachineCode(m, path, llvm::CGFT_AssemblyFile);
+		case EmitMode::BC:
+		case EmitMode::LL:
+		{
+			std::error_code EC;
+			llvm::raw_fd_ostream OS(path, EC, llvm::sys::fs::OF_None);
+			if (EC)
+			{
+				llvm::errs() << "cannot open '" << path << "': " << EC.message() << "\n";
+				return false;
+			}
+			if (mode == EmitMode::BC)
+				llvm::WriteBitcodeToFile(m, OS);
+			else
+				m.print(OS, nullptr);
+			return true;
+		}
+		case EmitMode::EXE:
+		{
+			const std::string object = baseName + getExtension(EmitMode::OBJ);
+			return emitMachineCode(m, object, llvm::CGFT_ObjectFile) && linkExecutable({ object }, path);
+		}
+		case EmitMode::JIT:
+		default:
+			return false;
+		}
+	}
+};
@@ -0,0 +1,344 @@
+#pragma once
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/Mangling.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TargetEmitter.h"
+#include "MessageEngine.h"
+extern void Info(MessageEngine::Code code, std::string_view additionalMsg);
+
+// Two-tier JIT execution. Every function except main is compiled quickly without optimization
+// (tier 0) behind a stub that calls through `<name>.tier.impl`. Tier 0 bodies count entries and
+// loop back-edges; when a counter reaches the threshold the function is re-read from a pristine
+// bitcode snapshot, optimized at -O3 on a background thread (tier 1) and the stub's pointer is
+// swapped. main itself is never promoted because it is entered only once.
+class TieredJIT final
+{
+public:
+	// Chooses the code generator level from the "du.tier" module flag, so both tiers share the
+	// LLJIT compile layer.
+	class TierCompiler final : public llvm::orc::IRCompileLayer::IRCompiler
+	{
+		llvm::orc::JITTargetMachineBuilder m_jtmb;
+	public:
+		TierCompiler(llvm::orc::JITTargetMachineBuilder jtmb)
+			: IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(jtmb.getOptions())), m_jtmb(std::move(jtmb))
+		{
+		}
+		virtual llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module& m) override
+		{
+			llvm::orc::JITTargetMachineBuilder jtmb = m_jtmb;
+			jtmb.setCodeGenOptLevel(getTier(m) ? llvm::CodeGenOpt::Aggressive : llvm::CodeGenOpt::None);
+			auto tm = jtmb.createTargetMachine();
+			if (!tm)
+				return tm.takeError();
+			return llvm::orc::SimpleCompiler(**tm)(m);
+		}
+	};
+
+	static constexpr uint64_t s_defaultThreshold = 10000;
+
+private:
+	static constexpr const char* s_tierFlag = "du.tier";
+	static constexpr const char* s_tierUp = "du.tier.up";
+
+	struct Tier
+	{
+		std::string name;
+		llvm::JITTargetAddress impl = 0;
+		std::atomic<bool> queued{ false };
+	};
+
+	llvm::orc::LLJIT& m_jit;
+	llvm::orc::JITTargetMachineBuilder m_jtmb;
+	uint64_t m_threshold;
+	llvm::SmallVector<char, 0> m_bitcode;
+	std::vector<std::unique_ptr<Tier>> m_tiers;
+	std::chrono::steady_clock::time_point m_start;
+	double m_tier0Time = 0;
+	double m_tier1Time = 0;
+	std::vector<std::string> m_events;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::queue<size_t> m_queue;
+	bool m_stop = false;
+	std::thread m_worker;
+
+	static inline std::atomic<TieredJIT*> s_active{ nullptr };
+
+	static unsigned getTier(const llvm::Module& m)
+	{
+		auto* flag = llvm::mdconst::extract_or_null<llvm::ConstantInt>(m.getModuleFlag(s_tierFlag));
+		return flag ? static_cast<unsigned>(flag->getZExtValue()) : 0;
+	}
+
+	static double elapsed(std::chrono::steady_clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	// Entry point for the tier 0 code, which reaches it through an absolute JIT symbol.
+	static void tierUp(int32_t id)
+	{
+		if (TieredJIT* self = s_active.load())
+			self->request(static_cast<size_t>(id));
+	}
+
+	void request(size_t id)
+	{
+		if (id >= m_tiers.size() || m_tiers[id]->queued.exchange(true))
+			return;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push(id);
+		}
+		m_cv.notify_one();
+	}
+
+	// Both tiers live in one JITDylib and reach each other by name, so nothing may stay local.
+	// Counters write memory, hence the inferred readnone/readonly attributes no longer hold.
+	static void prepare(llvm::Module& m)
+	{
+		for (llvm::GlobalValue& gv : m.global_values())
+		{
+			if (gv.hasLocalLinkage())
+			{
+				gv.setLinkage(llvm::GlobalValue::ExternalLinkage);
+				gv.setVisibility(llvm::GlobalValue::DefaultVisibility);
+			}
+		}
+		for (llvm::Function& fn : m)
+		{
+			if (fn.isIntrinsic())
+				continue;
+			fn.removeFnAttr(llvm::Attribute::ReadNone);
+			fn.removeFnAttr(llvm::Attribute::ReadOnly);
+		}
+	}
+
+	void insertCounter(llvm::Instruction* before, llvm::GlobalVariable* counter, llvm::FunctionCallee tierUp, int32_t id)
+	{
+		llvm::IRBuilder<> b(before);
+		llvm::Value* count = b.CreateAdd(b.CreateLoad(b.getInt64Ty(), counter), b.getInt64(1));
+		b.CreateStore(count, counter);
+		llvm::MDNode* cold = llvm::MDBuilder(b.getContext()).createBranchWeights(1, 1 << 20);
+		llvm::Instruction* then = llvm::SplitBlockAndInsertIfThen(b.CreateICmpEQ(count, b.getInt64(m_threshold)), before, false, cold);
+		b.SetInsertPoint(then);
+		b.CreateCall(tierUp, { b.getInt32(id) });
+	}
+
+	void instrument(llvm::Module& m)
+	{
+		llvm::IRBuilder<> b(m.getContext());
+		llvm::FunctionCallee tierUp = m.getOrInsertFunction(s_tierUp, b.getVoidTy(), b.getInt32Ty());
+		std::vector<llvm::Function*> functions;
+		for (llvm::Function& fn : m)
+		{
+			if (!fn.isDeclaration() && fn.getName() != "main")
+				functions.push_back(&fn);
+		}
+		for (llvm::Function* fn : functions)
+		{
+			const int32_t id = static_cast<int32_t>(m_tiers.size());
+			m_tiers.push_back(std::make_unique<Tier>());
+			m_tiers.back()->name = fn->getName().str();
+
+			auto* counter = new llvm::GlobalVariable(m, b.getInt64Ty(), false, llvm::GlobalValue::InternalLinkage, b.getInt64(0), fn->getName() + ".tier.count");
+			llvm::ValueToValueMapTy vmap;
+			llvm::Function* tier0 = llvm::CloneFunction(fn, vmap);
+			tier0->setName(fn->getName() + ".tier0");
+			tier0->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+			llvm::SmallVector<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>, 8> backEdges;
+			llvm::FindFunctionBackedges(*tier0, backEdges);
+			std::set<llvm::BasicBlock*> latches;
+			for (auto& [from, to] : backEdges)
+				latches.insert(const_cast<llvm::BasicBlock*>(from));
+			for (llvm::BasicBlock* latch : latches)
+				insertCounter(latch->getTerminator(), counter, tierUp, id);
+			llvm::BasicBlock::iterator entry = tier0->getEntryBlock().getFirstInsertionPt();
+			while (llvm::isa<llvm::AllocaInst>(*entry))
+				entry++;
+			insertCounter(&*entry, counter, tierUp, id);
+
+			auto* impl = new llvm::GlobalVariable(m, fn->getType(), false, llvm::GlobalValue::ExternalLinkage, tier0, fn->getName() + ".tier.impl");
+			const llvm::GlobalValue::LinkageTypes linkage = fn->getLinkage();
+			fn->deleteBody();
+			fn->setLinkage(linkage);
+			b.SetInsertPoint(llvm::BasicBlock::Create(m.getContext(), "tier_stub", fn));
+			llvm::LoadInst* target = b.CreateLoad(fn->getType(), impl);
+			target->setAtomic(llvm::AtomicOrdering::Monotonic);
+			target->setAlignment(m.getDataLayout().getPointerABIAlignment(0));
+			std::vector<llvm::Value*> args;
+			for (auto& it : fn->args())
+				args.push_back(&it);
+			llvm::CallInst* call = b.CreateCall(fn->getFunctionType(), target, args);
+			call->setCallingConv(fn->getCallingConv());
+			call->setTailCall();
+			if (fn->getReturnType()->isVoidTy())
+				b.CreateRetVoid();
+			else
+				b.CreateRet(call);
+		}
+	}
+
+	// Builds a module holding only the optimized copy of one function; everything else it
+	// references is resolved against the tier 0 module already in the JITDylib.
+	llvm::Error compileTier1(size_t id)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const std::string& name = m_tiers[id]->name;
+		auto context = std::make_unique<llvm::LLVMContext>();
+		auto loaded = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(m_bitcode.data(), m_bitcode.size()), name), *context);
+		if (!loaded)
+			return loaded.takeError();
+		std::unique_ptr<llvm::Module> m = std::move(*loaded);
+		for (llvm::Function& fn : *m)
+		{
+			if (fn.getName() != name && !fn.isDeclaration())
+				fn.deleteBody();
+		}
+		std::vector<llvm::GlobalVariable*> special;
+		for (llvm::GlobalVariable& gv : m->globals())
+		{
+			if (gv.getName().startswith("llvm."))
+				special.push_back(&gv);
+			else if (gv.hasInitializer())
+			{
+				gv.setInitializer(nullptr);
+				gv.setLinkage(llvm::GlobalValue::ExternalLinkage);
+			}
+		}
+		for (llvm::GlobalVariable* gv : special)
+			gv->eraseFromParent();
+
+		llvm::Function* fn = m->getFunction(name);
+		fn->setName(name + ".tier1");
+		m->addModuleFlag(llvm::Module::Warning, s_tierFlag, 1);
+		m->setDataLayout(m_jit.getDataLayout());
+		auto tm = m_jtmb.createTargetMachine();
+		if (!tm)
+			return tm.takeError();
+		TargetEmitter::optimize(*m, tm->get(), 3);
+		if (auto err = m_jit.addIRModule(llvm::orc::ThreadSafeModule(std::move(m), std::move(context))))
+			return err;
+		auto sym = m_jit.lookup(name + ".tier1");
+		if (!sym)
+			return sym.takeError();
+		auto* impl = llvm::jitTargetAddressToPointer<llvm::JITTargetAddress*>(m_tiers[id]->impl);
+		std::atomic_ref<llvm::JITTargetAddress>(*impl).store(sym->getAddress(), std::memory_order_release);
+
+		const double time = elapsed(start);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tier1Time += time;
+		m_events.push_back(std::format("{} promoted at +{:.2f} ms, tier 1 compile {:.2f} ms", name, elapsed(m_start) - time, time));
+		return llvm::Error::success();
+	}
+
+	void work()
+	{
+		while (true)
+		{
+			size_t id;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+				if (m_stop)
+					return;
+				id = m_queue.front();
+				m_queue.pop();
+			}
+			if (auto err = compileTier1(id))
+				llvm::errs() << "error tier 1 " << m_tiers[id]->name << ": " << llvm::toString(std::move(err)) << "\n";
+		}
+	}
+
+public:
+	TieredJIT(llvm::orc::LLJIT& jit, llvm::orc::JITTargetMachineBuilder jtmb, uint64_t threshold)
+		: m_jit(jit), m_jtmb(std::move(jtmb)), m_threshold(threshold ? threshold : s_defaultThreshold), m_start(std::chrono::steady_clock::now())
+	{
+		m_jtmb.setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+	}
+
+	TieredJIT(const TieredJIT&) = delete;
+	TieredJIT& operator=(const TieredJIT&) = delete;
+
+	// Snapshots the module for later promotions, instruments it and compiles it as tier 0.
+	llvm::Error addModule(llvm::orc::ThreadSafeModule tsm)
+	{
+		tsm.withModuleDo([this](llvm::Module& m)
+			{
+				m.setDataLayout(m_jit.getDataLayout());
+				prepare(m);
+				llvm::raw_svector_ostream OS(m_bitcode);
+				llvm::WriteBitcodeToFile(m, OS);
+				instrument(m);
+			});
+		const llvm::JITSymbolFlags flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+		llvm::orc::SymbolMap symbols;
+		symbols[m_jit.mangleAndIntern(s_tierUp)] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&TieredJIT::tierUp), flags);
+		if (auto err = m_jit.getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))))
+			return err;
+		if (auto err = m_jit.addIRModule(std::move(tsm)))
+			return err;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (auto& it : m_tiers)
+		{
+			auto sym = m_jit.lookup(it->name + ".tier.impl");
+			if (!sym)
+				return sym.takeError();
+			it->impl = sym->getAddress();
+		}
+		m_tier0Time = elapsed(start);
+		s_active = this;
+		m_worker = std::thread([this] { work(); });
+		return llvm::Error::success();
+	}
+
+	// Stops the background compiler; promotions still queued are dropped.
+	void finish()
+	{
+		if (s_active == this)
+			s_active = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cv.notify_one();
+		if (m_worker.joinable())
+			m_worker.join();
+	}
+
+	void reportStatistics()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Info(MessageEngine::Code::TIER_STATISTICS, std::format("tier 0 compile {:.2f} ms, {} functions", m_tier0Time, m_tiers.size()));
+		for (const std::string& it : m_events)
+			Info(MessageEngine::Code::TIER_STATISTICS, it);
+		Info(MessageEngine::Code::TIER_STATISTICS, std::format("tier 1 compile {:.2f} ms, {} promotions", m_tier1Time, m_events.size()));
+	}
+
+	~TieredJIT()
+	{
+		finish();
+	}
+};
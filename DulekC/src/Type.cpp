@@ -8,6 +8,7 @@
 #include <llvm-c/Core.h>
 #include <memory>
 #include <format>
+#include <vector>
 #include "DuObject.h"
 
 namespace LLVM_GEN
@@ -47,19 +48,96 @@ namespace LLVM_GEN
 		}
 	};
 }
-llvm::Type* SimpleNumericType::getLLVMType(llvm::LLVMContext& context)  const
+llvm::Type* Type::getLLVMType(llvm::LLVMContext& context) const
+{
+	if (m_typeId == s_noTypeId)
+		return createLLVMType(context);
+	// one slot per interned type id; each lowering thread works in one context at a time
+	struct Cache
+	{
+		const llvm::LLVMContext* context = nullptr;
+		uint64_t epoch = 0;
+		std::vector<llvm::Type*> types;
+	};
+	thread_local Cache cache;
+	const uint64_t epoch = s_llvmTypeEpoch.load(std::memory_order_acquire);
+	if (cache.context != &context || cache.epoch != epoch)
+	{
+		cache.context = &context;
+		cache.epoch = epoch;
+		std::fill(cache.types.begin(), cache.types.end(), nullptr);
+	}
+	if (m_typeId >= cache.types.size())
+		cache.types.resize(m_typeId + 1, nullptr);
+	llvm::Type*& slot = cache.types[m_typeId];
+	if (!slot)
+		slot = createLLVMType(context);
+	return slot;
+}
+
+llvm::Type* SimpleNumericType::createLLVMType(llvm::LLVMContext& context)  const
 {
 	LLVM_GEN::LLVMSimpleNumericType l;
 	return l.genType(m_size, m_isSigned, context);
 }
 
-llvm::Type* PointerType::getLLVMType(llvm::LLVMContext& context) const 
+llvm::Type* FloatingPointType::createLLVMType(llvm::LLVMContext& context) const
+{
+	return m_size == ObjectInByte::DWORD ? llvm::Type::getFloatTy(context) : llvm::Type::getDoubleTy(context);
+}
+
+llvm::Type* PointerType::createLLVMType(llvm::LLVMContext& context) const 
 {
 	llvm::Type* type = m_ptrType->getLLVMType(context);
 	LLVM_GEN::LLVMPointerTypeClass lptc;
 	return lptc.genType(type, context);
 }
 
+llvm::Type* ArrayType::createLLVMType(llvm::LLVMContext& context) const
+{
+	llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+	llvm::Type* data = m_elementType->getLLVMType(context)->getPointerTo();
+	return llvm::StructType::get(context, { data, llvm::ArrayType::get(i64, m_rank), llvm::ArrayType::get(i64, m_rank - 1) });
+}
+
+llvm::Type* VectorType::createLLVMType(llvm::LLVMContext& context) const
+{
+	return llvm::FixedVectorType::get(m_elementType->getLLVMType(context), m_lanes);
+}
+
+const Identifier VectorType::getTypeName() const
+{
+	return std::format("vec<{}, {}>", m_elementType->getIdentifier().getName(), m_lanes);
+}
+
+llvm::Type* RecordType::createLLVMType(llvm::LLVMContext& context) const
+{
+	std::vector<llvm::Type*> elements;
+	for (unsigned i : m_layout)
+		elements.push_back(m_fields[i].type->getLLVMType(context));
+	return llvm::StructType::get(context, elements);
+}
+
+llvm::Type* SoaType::createLLVMType(llvm::LLVMContext& context) const
+{
+	std::vector<llvm::Type*> elements;
+	for (unsigned i = 0; i < m_record->getFieldCount(); i++)
+		elements.push_back(m_record->getField(i).type->getLLVMType(context)->getPointerTo());
+	return llvm::StructType::get(context, elements);
+}
+
+const Identifier SoaType::getTypeName() const
+{
+	return std::format("soa<{}>", m_record->getIdentifier().getName());
+}
+
+const Identifier ArrayType::getTypeName() const
+{
+	if (m_rank == 1)
+		return std::format("slice<{}>", m_elementType->getIdentifier().getName());
+	return std::format("array{}<{}>", m_rank, m_elementType->getIdentifier().getName());
+}
+
 
 const Identifier PointerType::getTypeName() const 
 {
@@ -73,6 +151,10 @@ const Identifier PointerType::getTypeName() const
 	{
 		val = Type::generateId(snt->getObjectInByte(), snt->isSigned()).getName();
 	}
+	else if (m_ptrType)
+	{
+		val = m_ptrType->getIdentifier().getName();
+	}
 	return std::format("pointer<{}>", val);
 }
 
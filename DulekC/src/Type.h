@@ -10,6 +10,10 @@
 #include "DuObject.h"
 #include <llvm/IR/IRBuilder.h>
 #include "Value.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 enum class ObjectInByte : unsigned char
 {
 	BOOLEAN,
@@ -25,19 +29,49 @@ enum class ObjectInByte : unsigned char
 
 
 
+class PointerType;
+
 class Type : public DuObject
 {
-	
+public:
+	static constexpr uint32_t s_noTypeId = UINT32_MAX;
+private:
+	uint32_t m_typeId = s_noTypeId;
+	mutable std::atomic<PointerType*> m_pointerTo{ nullptr };
+	static inline std::atomic<uint64_t> s_llvmTypeEpoch{ 0 };
+protected:
+	// Lowers the type; getLLVMType caches the result per thread and context for interned types.
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const = 0;
 public:
 	Type(const Identifier& id) : DuObject(id) {};
 	virtual bool isSimpleNumericType() const { return false; }
+	virtual bool isFloatingPointType() const { return false; }
 	virtual bool isType() const override { return true; }
 	virtual Value* getDefaultValue() const = 0;
 	virtual Value* convertLLVMToValue(llvm::Value* lv) const = 0;
-	virtual llvm::Type* getLLVMType(llvm::LLVMContext&) const override
+	virtual llvm::Type* getLLVMType(llvm::LLVMContext&) const override final;
+
+	uint32_t getTypeId() const
 	{
-		return nullptr;
-	};
+		return m_typeId;
+	}
+	void setTypeId(uint32_t id)
+	{
+		m_typeId = id;
+	}
+	PointerType* getPointerTo() const
+	{
+		return m_pointerTo.load(std::memory_order_acquire);
+	}
+	void setPointerTo(PointerType* pt) const
+	{
+		m_pointerTo.store(pt, std::memory_order_release);
+	}
+	// Drops every cached lowering; called before an LLVMContext that lowered Du types goes away.
+	static void releaseLLVMTypes()
+	{
+		s_llvmTypeEpoch++;
+	}
 
 	static Identifier generateId(ObjectInByte id, bool isSigned)
 	{
@@ -77,11 +111,16 @@ public:
 		assert(0);
 		return nullptr;
 	}
-	virtual llvm::Value* convertValueBasedOnType(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type, llvm::LLVMContext& context)
+	// `sourceSigned` tells how an integer `value` widens into a floating point type.
+	virtual llvm::Value* convertValueBasedOnType(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type, llvm::LLVMContext& context, bool sourceSigned = true)
 	{
 		return nullptr;
 	}
 	virtual size_t getSizeInBytes() const = 0;
+	virtual size_t getAlignmentInBytes() const
+	{
+		return getSizeInBytes();
+	}
 	virtual ~Type() {}
 
 	enum ID
@@ -96,6 +135,8 @@ public:
 		U32,
 		I64,
 		U64,
+		F32,
+		F64,
 		END_TYPE
 	};
 
@@ -125,6 +166,11 @@ public:
 			return "i32";
 		case ID::I64:
 			return "i64";
+
+		case ID::F32:
+			return "f32";
+		case ID::F64:
+			return "f64";
 		default:
 			return nullptr;
 		}
@@ -142,8 +188,14 @@ public:
 
 	virtual bool isSimpleNumericType() const override { return true; }
 	SimpleNumericType(const Identifier& id, const ObjectInByte oib, const bool isSigned) : Type(id), m_size(oib), m_isSigned(isSigned) {}
-	virtual llvm::Type* getLLVMType (llvm::LLVMContext&) const override;
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
 	const bool isSigned() const { return m_isSigned; }
+	// Bool and unsigned integers convert as unsigned values; every other type as signed.
+	static bool isSignedSource(Type* source)
+	{
+		auto* numeric = dynamic_cast<SimpleNumericType*>(source);
+		return !numeric || (numeric->isSigned() && numeric->getObjectInByte() != ObjectInByte::BOOLEAN);
+	}
 	virtual size_t getSizeInBytes() const override
 	{
 		switch (m_size)
@@ -166,7 +218,7 @@ public:
 	{
 		return m_size;
 	}
-	virtual llvm::Value* convertValueBasedOnType(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type, llvm::LLVMContext& context) override
+	virtual llvm::Value* convertValueBasedOnType(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type, llvm::LLVMContext& context, bool sourceSigned = true) override
 	{
 		auto myType = getLLVMType(context);
 
@@ -187,6 +239,12 @@ public:
 				return builder.CreateBitCast(value, myType, "bitcastVal");
 			}
 		}
+		else if (type->isFloatingPointTy() && myType->isIntegerTy())
+		{
+			if (m_isSigned)
+				return builder.CreateFPToSI(value, myType, "fpToInt");
+			return builder.CreateFPToUI(value, myType, "fpToInt");
+		}
 		return value;
 
 	}
@@ -207,6 +265,54 @@ public:
 
 
 
+// `f32` and `f64`, the IEEE single and double types. Integers convert to them with their own
+// signedness, bool as 0 or 1; arithmetic on them is strict unless the function is `fastmath` or -fastmath is given.
+class FloatingPointType final : public Type
+{
+private:
+	ObjectInByte m_size;
+public:
+	FloatingPointType(const Identifier& id, const ObjectInByte oib) : Type(id), m_size(oib) {}
+	virtual bool isFloatingPointType() const override { return true; }
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
+	virtual size_t getSizeInBytes() const override
+	{
+		return m_size == ObjectInByte::DWORD ? sizeof(float) : sizeof(double);
+	}
+	ObjectInByte getObjectInByte() const
+	{
+		return m_size;
+	}
+	virtual llvm::Value* convertValueBasedOnType(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type, llvm::LLVMContext& context, bool sourceSigned = true) override
+	{
+		llvm::Type* myType = getLLVMType(context);
+		if (type->isIntegerTy())
+		{
+			if (sourceSigned && !type->isIntegerTy(1))
+				return builder.CreateSIToFP(value, myType, "intToFp");
+			return builder.CreateUIToFP(value, myType, "intToFp");
+		}
+		if (type->isFloatingPointTy() && type != myType)
+			return builder.CreateFPCast(value, myType, "fpCast");
+		return value;
+	}
+	virtual Value* getDefaultValue() const override
+	{
+		return new NumericValue();
+	}
+	virtual Value* convertLLVMToValue(llvm::Value* lv) const override
+	{
+		return nullptr;
+	}
+	DuObject* copy() const override
+	{
+		return new FloatingPointType(getIdentifier(), m_size);
+	}
+	virtual ~FloatingPointType() {}
+};
+
+
+
 class PointerType : public Type
 {
 private:
@@ -244,7 +350,7 @@ public:
 		setIdentifier(getTypeName());
 	}
 	PointerType(Identifier id, Type* ptrType) : Type(id), m_ptrType(ptrType) {}
-	virtual llvm::Type* getLLVMType(llvm::LLVMContext&) const override;
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
 	const Identifier getTypeName() const;
 	virtual Value* getDefaultValue() const override
 	{
@@ -272,4 +378,310 @@ public:
 		return PtrIterator(m_ptrType);
 	}
 	virtual ~PointerType() {}
-};
\ No newline at end of file
+};
+
+
+
+// `arrayN<T>`: an N-dimensional row-major array in one allocation. The value is a descriptor
+// { T* data, [N x i64] extents, [N-1 x i64] strides } with strides in elements, so indexing is
+// a single GEP and the innermost dimension is always unit stride. `slice<T>` is the rank 1
+// case: a pointer and its length.
+class ArrayType final : public Type
+{
+private:
+	Type* m_elementType;
+	uint32_t m_rank;
+public:
+	enum Field : unsigned
+	{
+		DATA = 0,
+		EXTENTS,
+		STRIDES,
+	};
+	ArrayType(Type* elementType, uint32_t rank) : Type(""), m_elementType(elementType), m_rank(rank)
+	{
+		setIdentifier(getTypeName());
+	}
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
+	const Identifier getTypeName() const;
+	virtual Value* getDefaultValue() const override
+	{
+		return nullptr;
+	}
+	virtual Value* convertLLVMToValue(llvm::Value* lv) const override
+	{
+		return nullptr;
+	}
+	DuObject* copy() const override
+	{
+		return nullptr;
+	}
+	virtual size_t getSizeInBytes() const override
+	{
+		return sizeof(void*) + (2 * m_rank - 1) * sizeof(int64_t);
+	}
+	virtual size_t getAlignmentInBytes() const override
+	{
+		return sizeof(int64_t);
+	}
+	Type* getElementType() const
+	{
+		return m_elementType;
+	}
+	uint32_t getRank() const
+	{
+		return m_rank;
+	}
+	// Parameters are passed as the flattened descriptor: data, extents, strides.
+	unsigned getFieldCount() const
+	{
+		return 2 * m_rank;
+	}
+	virtual ~ArrayType() {}
+};
+
+
+
+// `vec<T, N>`: N lanes of an integer or floating point T, lowered to an LLVM fixed vector that
+// the backend splits or widens to the target's registers. `vec<bool, N>` is the mask a lane-wise
+// comparison produces. A scalar converts to a vector by splatting it across the lanes.
+class VectorType final : public Type
+{
+private:
+	Type* m_elementType;
+	uint32_t m_lanes;
+public:
+	static constexpr uint32_t s_maxLanes = 64;
+	VectorType(Type* elementType, uint32_t lanes) : Type(""), m_elementType(elementType), m_lanes(lanes)
+	{
+		setIdentifier(getTypeName());
+	}
+	// Lane counts are powers of two, so the vector size is one too and doubles as its alignment.
+	static bool isValidLaneCount(uint64_t lanes)
+	{
+		return lanes >= 2 && lanes <= s_maxLanes && !(lanes & (lanes - 1));
+	}
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
+	const Identifier getTypeName() const;
+	virtual Value* getDefaultValue() const override
+	{
+		return new NumericValue();
+	}
+	virtual Value* convertLLVMToValue(llvm::Value* lv) const override
+	{
+		return nullptr;
+	}
+	DuObject* copy() const override
+	{
+		return nullptr;
+	}
+	virtual size_t getSizeInBytes() const override
+	{
+		if (isMask())
+			return (m_lanes + 7) / 8;
+		return m_elementType->getSizeInBytes() * m_lanes;
+	}
+	virtual llvm::Value* convertValueBasedOnType(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type, llvm::LLVMContext& context, bool sourceSigned = true) override
+	{
+		if (type->isVectorTy())
+			return value;
+		value = m_elementType->convertValueBasedOnType(builder, value, type, context, sourceSigned);
+		return builder.CreateVectorSplat(m_lanes, value, "splat");
+	}
+	Type* getElementType() const
+	{
+		return m_elementType;
+	}
+	uint32_t getLanes() const
+	{
+		return m_lanes;
+	}
+	bool isMask() const
+	{
+		auto* numeric = dynamic_cast<SimpleNumericType*>(m_elementType);
+		return numeric && numeric->getObjectInByte() == ObjectInByte::BOOLEAN;
+	}
+	bool isSigned() const
+	{
+		auto* numeric = dynamic_cast<SimpleNumericType*>(m_elementType);
+		return !numeric || numeric->isSigned();
+	}
+	virtual ~VectorType() {}
+};
+
+
+
+// `struct Name(field -> T, ...)`: a record lowered to a literal LLVM struct. Fields are laid out
+// by decreasing alignment, which for power-of-two sized fields leaves padding only at the tail;
+// `ordered struct` keeps the declaration order, e.g. to match a C layout. Fields are always
+// named by their declaration index; getElementIndex maps that to the struct element.
+class RecordType final : public Type
+{
+public:
+	struct Field
+	{
+		Identifier name;
+		Type* type;
+	};
+private:
+	std::vector<Field> m_fields;
+	std::vector<unsigned> m_layout;
+	std::vector<unsigned> m_elementIndex;
+	size_t m_size = 0;
+	size_t m_alignment = 1;
+	bool m_keepOrder;
+
+	// Size of the record with its fields placed in `order`, tail padding included.
+	size_t computeSize(const std::vector<unsigned>& order) const
+	{
+		size_t offset = 0;
+		size_t alignment = 1;
+		for (unsigned i : order)
+		{
+			const size_t fieldAlignment = m_fields[i].type->getAlignmentInBytes();
+			offset = (offset + fieldAlignment - 1) / fieldAlignment * fieldAlignment + m_fields[i].type->getSizeInBytes();
+			alignment = std::max(alignment, fieldAlignment);
+		}
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+public:
+	RecordType(const Identifier& id, std::vector<Field>&& fields, bool keepOrder) : Type(id), m_fields(std::move(fields)), m_keepOrder(keepOrder)
+	{
+		for (unsigned i = 0; i < m_fields.size(); i++)
+		{
+			m_layout.push_back(i);
+			m_alignment = std::max(m_alignment, m_fields[i].type->getAlignmentInBytes());
+		}
+		if (!m_keepOrder)
+		{
+			std::stable_sort(m_layout.begin(), m_layout.end(), [this](unsigned l, unsigned r) {
+				return m_fields[l].type->getAlignmentInBytes() > m_fields[r].type->getAlignmentInBytes();
+			});
+		}
+		m_elementIndex.resize(m_fields.size());
+		for (unsigned i = 0; i < m_layout.size(); i++)
+			m_elementIndex[m_layout[i]] = i;
+		m_size = computeSize(m_layout);
+	}
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
+	virtual Value* getDefaultValue() const override
+	{
+		return new NumericValue();
+	}
+	virtual Value* convertLLVMToValue(llvm::Value* lv) const override
+	{
+		return nullptr;
+	}
+	DuObject* copy() const override
+	{
+		return nullptr;
+	}
+	virtual size_t getSizeInBytes() const override
+	{
+		return m_size;
+	}
+	virtual size_t getAlignmentInBytes() const override
+	{
+		return m_alignment;
+	}
+	size_t getDeclaredOrderSize() const
+	{
+		std::vector<unsigned> order(m_fields.size());
+		for (unsigned i = 0; i < order.size(); i++)
+			order[i] = i;
+		return computeSize(order);
+	}
+	size_t getPaddingInBytes() const
+	{
+		size_t fields = 0;
+		for (const Field& field : m_fields)
+			fields += field.type->getSizeInBytes();
+		return m_size - fields;
+	}
+	// Declaration index of `name`, or getFieldCount() when there is no such field.
+	unsigned findField(const Identifier& name) const
+	{
+		for (unsigned i = 0; i < m_fields.size(); i++)
+		{
+			if (m_fields[i].name == name)
+				return i;
+		}
+		return getFieldCount();
+	}
+	unsigned getFieldCount() const
+	{
+		return static_cast<unsigned>(m_fields.size());
+	}
+	const Field& getField(unsigned i) const
+	{
+		return m_fields[i];
+	}
+	unsigned getElementIndex(unsigned i) const
+	{
+		return m_elementIndex[i];
+	}
+	const std::vector<unsigned>& getLayout() const
+	{
+		return m_layout;
+	}
+	bool keepsDeclarationOrder() const
+	{
+		return m_keepOrder;
+	}
+	virtual ~RecordType() {}
+};
+
+
+
+// `soa<R>`: an array of R stored field by field, so a loop touching one field walks unit stride
+// memory. The value holds one pointer per field in declaration order; `new soa<R>(n)` carves
+// every field array out of one block, most aligned field first so each array stays aligned,
+// and `s[i].field` indexes the field's array.
+class SoaType final : public Type
+{
+private:
+	RecordType* m_record;
+	std::vector<unsigned> m_allocationOrder;
+public:
+	SoaType(RecordType* record) : Type(""), m_record(record)
+	{
+		setIdentifier(getTypeName());
+		for (unsigned i = 0; i < m_record->getFieldCount(); i++)
+			m_allocationOrder.push_back(i);
+		std::stable_sort(m_allocationOrder.begin(), m_allocationOrder.end(), [this](unsigned l, unsigned r) {
+			return m_record->getField(l).type->getAlignmentInBytes() > m_record->getField(r).type->getAlignmentInBytes();
+		});
+	}
+	virtual llvm::Type* createLLVMType(llvm::LLVMContext&) const override;
+	const Identifier getTypeName() const;
+	virtual Value* getDefaultValue() const override
+	{
+		return nullptr;
+	}
+	virtual Value* convertLLVMToValue(llvm::Value* lv) const override
+	{
+		return nullptr;
+	}
+	DuObject* copy() const override
+	{
+		return nullptr;
+	}
+	virtual size_t getSizeInBytes() const override
+	{
+		return sizeof(void*) * m_record->getFieldCount();
+	}
+	virtual size_t getAlignmentInBytes() const override
+	{
+		return sizeof(void*);
+	}
+	RecordType* getRecordType() const
+	{
+		return m_record;
+	}
+	// Field arrays in block order; the first one starts the block and carries its alignment.
+	const std::vector<unsigned>& getAllocationOrder() const
+	{
+		return m_allocationOrder;
+	}
+	virtual ~SoaType() {}
+};
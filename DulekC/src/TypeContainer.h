@@ -2,74 +2,161 @@
 #include <map>
 #include "Type.h"
 #include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 class TypeContainer
 {
 	bool m_isInited = false;
 	struct TypeContainerHash
 	{
 		size_t operator()(const Identifier& id)const {
-			std::hash<std::string>h;
-			return h(id.getName().data());
+			std::hash<std::string_view>h;
+			return h(id.getName());
 		}
 	};
-	using TypeMap = std::unordered_map < Identifier, std::unique_ptr<Type>, TypeContainerHash>;
-	TypeMap m_typeMap;
-	
-public:
-	using Iterator = TypeMap::iterator;
-	template<typename T, typename... Args>
-	void insert(const Identifier id, Args&&... args )
+	enum class Kind : uint8_t
 	{
-		static_assert(std::is_base_of<Type, T>::value, "T must be a type derived from Type");
-		auto it = m_typeMap.find(id);
-		if (it != m_typeMap.end())
-			return;
-		m_typeMap.insert({ id, std::make_unique<T>(std::forward<Args>(args)...) });
+		NUMERIC = 0,
+		POINTER,
+		ARRAY,
+		FLOAT,
+		VECTOR,
+		RECORD,
+		SOA,
+	};
+	// Types are interned by structure (kind, width, array rank or lanes, signedness, pointee id) packed in one word,
+	// so no name is formatted to find a type; the id also indexes the lowering cache in Type.
+	static uint64_t makeKey(Kind kind, ObjectInByte width, bool isSigned, uint32_t pointee)
+	{
+		return (static_cast<uint64_t>(kind) << 48) | (static_cast<uint64_t>(width) << 40) | (static_cast<uint64_t>(isSigned) << 32) | pointee;
 	}
+	static constexpr size_t s_widths = static_cast<size_t>(ObjectInByte::QWORD) + 1;
+
+	std::vector<std::unique_ptr<Type>> m_types;
+	std::unordered_map<uint64_t, Type*> m_structural;
+	std::unordered_map<Identifier, Type*, TypeContainerHash> m_byName;
+	SimpleNumericType* m_numeric[s_widths][2] = {};
+	FloatingPointType* m_float[2] = {};
+	std::mutex m_mutex;
 
-	static std::string generatePointerType(std::vector<Type::ID> ids)
+	template<typename T>
+	T* add(uint64_t key, std::unique_ptr<T> type)
 	{
-		std::string name = "pointer<";
-		Type::ID id = ids[0];
-		ids.erase(ids.begin());
-		if (id == Type::ID::POINTER)
-		{
-			name += generatePointerType(ids);
-		}
-		else
-		{
-			name += Type::getName(id);
-		}
-		name += ">";
-		return name;
+		T* ret = type.get();
+		ret->setTypeId(static_cast<uint32_t>(m_types.size()));
+		m_byName.try_emplace(ret->getIdentifier(), ret);
+		m_structural.emplace(key, ret);
+		m_types.push_back(std::move(type));
+		return ret;
 	}
 
+	void addNumeric(ObjectInByte width, bool isSigned)
+	{
+		Identifier id = Type::generateId(width, isSigned);
+		m_numeric[static_cast<size_t>(width)][isSigned] = add(makeKey(Kind::NUMERIC, width, isSigned, 0), std::make_unique<SimpleNumericType>(id, width, isSigned));
+	}
+
+	void addFloat(ObjectInByte width)
+	{
+		const bool isDouble = width == ObjectInByte::QWORD;
+		Identifier id(Type::getName(isDouble ? Type::ID::F64 : Type::ID::F32));
+		m_float[isDouble] = add(makeKey(Kind::FLOAT, width, false, 0), std::make_unique<FloatingPointType>(id, width));
+	}
+
+public:
 	void init()
 	{
 		if (m_isInited)
 			return;
 		m_isInited = true;
-		insert<SimpleNumericType>(Identifier(Type::getName(Type::ID::BOOL)), Identifier(Type::getName(Type::ID::BOOL)), ObjectInByte::BOOLEAN, false);
+		addNumeric(ObjectInByte::BOOLEAN, false);
+		m_numeric[static_cast<size_t>(ObjectInByte::BOOLEAN)][true] = m_numeric[static_cast<size_t>(ObjectInByte::BOOLEAN)][false];
+		for (ObjectInByte width : { ObjectInByte::BYTE, ObjectInByte::WORD, ObjectInByte::DWORD, ObjectInByte::QWORD })
+		{
+			addNumeric(width, false);
+			addNumeric(width, true);
+		}
+		addFloat(ObjectInByte::DWORD);
+		addFloat(ObjectInByte::QWORD);
+		getPointerType(getNumericType(ObjectInByte::BYTE, false));
+	}
 
-		insert<SimpleNumericType>(Type::getName(Type::ID::U8), Identifier(Type::getName(Type::ID::U8)), ObjectInByte::BYTE, false);
-		insert<SimpleNumericType>(Type::getName(Type::ID::U16), Identifier(Type::getName(Type::ID::U16)), ObjectInByte::WORD, false);
-		insert<SimpleNumericType>(Type::getName(Type::ID::U32), Identifier(Type::getName(Type::ID::U32)), ObjectInByte::DWORD, false);
-		insert<SimpleNumericType>(Type::getName(Type::ID::U64), Identifier(Type::getName(Type::ID::U64)), ObjectInByte::QWORD, false);
+	SimpleNumericType* getNumericType(ObjectInByte width, bool isSigned) const
+	{
+		const size_t index = static_cast<size_t>(width);
+		return index < s_widths ? m_numeric[index][isSigned] : nullptr;
+	}
+
+	// f32 is the DWORD width, f64 the QWORD one.
+	FloatingPointType* getFloatingPointType(ObjectInByte width) const
+	{
+		if (width == ObjectInByte::DWORD)
+			return m_float[false];
+		return width == ObjectInByte::QWORD ? m_float[true] : nullptr;
+	}
 
-		insert<SimpleNumericType>(Identifier(Type::getName(Type::ID::I8)), Identifier(Type::getName(Type::ID::I8)), ObjectInByte::BYTE, true);
-		insert<SimpleNumericType>(Identifier(Type::getName(Type::ID::I16)), Identifier(Type::getName(Type::ID::I16)), ObjectInByte::WORD, true);
-		insert<SimpleNumericType>(Identifier(Type::getName(Type::ID::I32)), Identifier(Type::getName(Type::ID::I32)), ObjectInByte::DWORD, true);
-		insert<SimpleNumericType>(Identifier(Type::getName(Type::ID::I64)), Identifier(Type::getName(Type::ID::I64)), ObjectInByte::QWORD, true);
-		insert<PointerType>(generatePointerType({ Type::ID::U8 }), getType(Type::getName(Type::ID::U8)));
-		
+	PointerType* getPointerType(Type* pointee)
+	{
+		if (PointerType* pt = pointee->getPointerTo())
+			return pt;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const uint64_t key = makeKey(Kind::POINTER, ObjectInByte::POINTER, false, pointee->getTypeId());
+		auto it = m_structural.find(key);
+		if (it != m_structural.end() && pointee->getTypeId() != Type::s_noTypeId)
+			return static_cast<PointerType*>(it->second);
+		PointerType* pt = add(key, std::make_unique<PointerType>(pointee));
+		pointee->setPointerTo(pt);
+		return pt;
+	}
 
+	ArrayType* getArrayType(Type* element, uint32_t rank)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const uint64_t key = makeKey(Kind::ARRAY, static_cast<ObjectInByte>(rank), false, element->getTypeId());
+		auto it = m_structural.find(key);
+		if (it != m_structural.end() && element->getTypeId() != Type::s_noTypeId)
+			return static_cast<ArrayType*>(it->second);
+		return add(key, std::make_unique<ArrayType>(element, rank));
+	}
+
+	VectorType* getVectorType(Type* element, uint32_t lanes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const uint64_t key = makeKey(Kind::VECTOR, static_cast<ObjectInByte>(lanes), false, element->getTypeId());
+		auto it = m_structural.find(key);
+		if (it != m_structural.end() && element->getTypeId() != Type::s_noTypeId)
+			return static_cast<VectorType*>(it->second);
+		return add(key, std::make_unique<VectorType>(element, lanes));
+	}
+
+	// Records are nominal, so each declaration gets its own key; returns nullptr when the name is already taken.
+	RecordType* addRecordType(const Identifier& id, std::vector<RecordType::Field>&& fields, bool keepOrder)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_byName.count(id))
+			return nullptr;
+		const uint64_t key = makeKey(Kind::RECORD, ObjectInByte::BOOLEAN, false, static_cast<uint32_t>(m_types.size()));
+		return add(key, std::make_unique<RecordType>(id, std::move(fields), keepOrder));
+	}
+
+	SoaType* getSoaType(RecordType* record)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const uint64_t key = makeKey(Kind::SOA, ObjectInByte::BOOLEAN, false, record->getTypeId());
+		auto it = m_structural.find(key);
+		if (it != m_structural.end())
+			return static_cast<SoaType*>(it->second);
+		return add(key, std::make_unique<SoaType>(record));
 	}
 
 	Type* getType(const Identifier id)
 	{
-		auto ret = m_typeMap.find(id);
-		if (ret != m_typeMap.end())
-			return ret->second.get();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto ret = m_byName.find(id);
+		if (ret != m_byName.end())
+			return ret->second;
 		else
 			return nullptr;
 	}
@@ -81,4 +168,3 @@ public:
 	}
 
 };
-
@@ -44,12 +44,18 @@ public:
 	}
 	virtual llvm::Value* getLLVMValue(llvm::Type* type) const override
 	{
+		// the lexer keeps negative literals as two's complement; vector types get the value splatted,
+		// records and descriptors of arrays start zeroed
+		if (type->isAggregateType())
+			return llvm::Constant::getNullValue(type);
+		if (type->getScalarType()->isFloatingPointTy())
+			return llvm::ConstantFP::get(type, static_cast<double>(static_cast<int64_t>(m_value)));
 		return llvm::ConstantInt::get(type, m_value, m_isSigned);
 	}
 	virtual llvm::Value* getLLVMValue(llvm::IRBuilder<>& builder, llvm::Type* type) const override
 	{
 		llvm::Value* var = builder.CreateAlloca(type, nullptr, "numeric_value");
-		llvm::Value* valueToStore = llvm::ConstantInt::get(type, m_value, m_isSigned);
+		llvm::Value* valueToStore = getLLVMValue(type);
 		builder.CreateStore(valueToStore, var);
 		llvm::Value* load = builder.CreateLoad(type, var);
 		return load;
@@ -71,5 +77,26 @@ public:
 	virtual ~NumericValue() {}
 };
 
+// A literal with a fraction or an exponent; only floating point variables take it.
+class FloatingPointValue : public Value
+{
+	double m_value;
+public:
+	FloatingPointValue(const double d = 0.0) : Value(Identifier(std::to_string(d)))
+	{
+		m_value = d;
+	}
+	virtual llvm::Value* getLLVMValue(llvm::Type* type) const override
+	{
+		return llvm::ConstantFP::get(type, m_value);
+	}
+	double loadValue() const { return m_value; }
+	virtual DuObject* copy() const override
+	{
+		return new FloatingPointValue(loadValue());
+	}
+	virtual ~FloatingPointValue() {}
+};
+
 
 
@@ -5,6 +5,8 @@
 #include "TypeContainer.h"
 #include "LexerContext.h"
 #include "MessageEngine.h"
+#include <map>
+#include <mutex>
 class AstTree;
 #define DECLARELLVM(X) mutable llvm::##X* m_llvm##X
 extern void Error(MessageEngine::Code code, std::string_view additionalMsg);
@@ -21,6 +23,23 @@ class Variable : public DuObject
 	bool m_isGlobal;
 	bool m_isTmp = false;
 	bool m_hasBooleanValue;
+	uint64_t m_alignment = 0;
+	// Context-bound state of a global while a worker lowers one function into its own context.
+	// Globals are shared by every worker, so theirs lives here instead of on the node; the shared
+	// Value is only touched under s_sharedValueLock.
+	struct LoweringState
+	{
+		llvm::Value* value = nullptr;
+		llvm::Value* alloca = nullptr;
+	};
+	static inline thread_local std::map<const Variable*, LoweringState>* s_workerState = nullptr;
+	static inline std::mutex s_sharedValueLock;
+	LoweringState* getWorkerState() const
+	{
+		if (!m_isGlobal || !s_workerState)
+			return nullptr;
+		return &(*s_workerState)[this];
+	}
 	llvm::Value* _getLLVMValue(llvm::Type* type) const
 	{
 		if (!m_value)
@@ -37,6 +56,16 @@ class Variable : public DuObject
 	{
 		if (m_value && m_type )
 		{
+			if (m_type->isFloatingPointType())
+				return m_value->getLLVMValue(type);
+			if (VectorType* vt = dynamic_cast<VectorType*>(m_type))
+			{
+				if (!m_value->isNumericValue() && !vt->getElementType()->isFloatingPointType())
+					Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, getIdentifier().getName());
+				return m_value->getLLVMValue(type);
+			}
+			if (dynamic_cast<FloatingPointValue*>(m_value))
+				Error(MessageEngine::Code::INVALID_ARGUMENT_TYPE, getIdentifier().getName());
 			if ( m_value->isNumericValue() )
 			{
 				
@@ -54,6 +83,10 @@ class Variable : public DuObject
 					llvmVal = builder.CreateIntToPtr(llvmVal, pt->getLLVMType(builder.getContext()), "CreateIntToPtr");
 					return llvmVal;
 				}
+				else if (dynamic_cast<ArrayType*>(m_type) || dynamic_cast<RecordType*>(m_type) || dynamic_cast<SoaType*>(m_type))
+				{
+					return llvm::Constant::getNullValue(type);
+				}
 			}
 		}
 		return nullptr;
@@ -80,16 +113,33 @@ class Variable : public DuObject
 public:
 	Variable(Identifier id, Type* type, Value* val, bool globalScope) : DuObject(id), m_type(type), m_value(val), m_isGlobal(globalScope), 
 		m_llvmType(nullptr), m_llvmValue(nullptr), m_llvmAllocaInst(nullptr), m_hasBooleanValue(false) {}
+	// Lowering a function in a worker thread keeps the state of globals in this scope's storage.
+	class WorkerScope final
+	{
+		std::map<const Variable*, LoweringState> m_state;
+	public:
+		WorkerScope() { s_workerState = &m_state; }
+		~WorkerScope() { s_workerState = nullptr; }
+	};
 	virtual bool isVariable() const override { return true; }
 	virtual llvm::Type* getLLVMType(llvm::LLVMContext& context) const override
 	{
-		if (!m_llvmType)
+		if (getWorkerState())
+			return m_type->getLLVMType(context);
+		if (!m_llvmType || &m_llvmType->getContext() != &context)
 			m_llvmType = m_type->getLLVMType(context);
 		return m_llvmType;
 		
 	}
 	virtual llvm::Value* getLLVMValue(llvm::Type* type) const override
 	{
+		if (LoweringState* state = getWorkerState())
+		{
+			std::lock_guard<std::mutex> guard(s_sharedValueLock);
+			if (!state->value)
+				state->value = _getLLVMValue(type);
+			return state->value;
+		}
 		if (!m_llvmValue)
 			m_llvmValue = _getLLVMValue(type);
 		return m_llvmValue;
@@ -98,24 +148,44 @@ public:
 
 	llvm::Value* init(llvm::AllocaInst* inst, llvm::IRBuilder<>& builder)
 	{
-		if (m_llvmAllocaInst)
+		if (getAlloca())
 			return nullptr;
 		auto align = getAlligment();
 		inst->setAlignment(align);
-		m_llvmAllocaInst = inst;
+		setAlloca(inst);
+		std::unique_lock<std::mutex> guard(s_sharedValueLock, std::defer_lock);
+		if (getWorkerState())
+			guard.lock();
 		return initValue(builder, getLLVMType(builder.getContext()));
 	}
 	void setAlloca(llvm::Value* inst)
 	{
-		m_llvmAllocaInst = inst;
+		if (LoweringState* state = getWorkerState())
+			state->alloca = inst;
+		else
+			m_llvmAllocaInst = inst;
 	}
 	llvm::Value* getAlloca()
 	{
+		if (LoweringState* state = getWorkerState())
+			return state->alloca;
 		return m_llvmAllocaInst;
 	}
 	const llvm::Align getAlligment() const
 	{
-		return llvm::Align(m_type->getSizeInBytes());
+		return llvm::Align(std::max<uint64_t>(m_type->getAlignmentInBytes(), m_alignment));
+	}
+	// `x -> T align(N)`; N must be a power of two.
+	void setAlignment(uint64_t alignment)
+	{
+		if (!alignment || (alignment & (alignment - 1)))
+			Error(MessageEngine::Code::WRONG_ARGUMENT, "align(" + std::to_string(alignment) + ")");
+		else
+			m_alignment = alignment;
+	}
+	bool hasExplicitAlignment() const
+	{
+		return m_alignment != 0;
 	}
 	bool isGlobalVariable() const
 	{
@@ -146,6 +216,7 @@ public:
 		if (m_hasBooleanValue)
 			variable->setBooleanValue();
 		variable->setKey(getKey());
+		variable->m_alignment = m_alignment;
 		return variable;
 	}
 	void setTmp()
@@ -160,7 +231,7 @@ public:
 	void setBooleanValue()
 	{
 		m_hasBooleanValue = true;
-		m_type = TypeContainer::instance().getType(Type::getName(Type::ID::BOOL));
+		m_type = TypeContainer::instance().getNumericType(ObjectInByte::BOOLEAN, false);
 		m_llvmType = nullptr;
 	}
 
@@ -176,6 +247,11 @@ public:
 		{
 			return b.CreateICmpNE(getLLVMValue(getLLVMType(c)), b.getInt32(0), "int to bool");
 		}
+		if (m_type->isFloatingPointType())
+		{
+			llvm::Type* type = getLLVMType(c);
+			return b.CreateFCmpUNE(getLLVMValue(type), llvm::ConstantFP::get(type, 0.0), "fp to bool");
+		}
 		Error(MessageEngine::Code::CannotConvertToBoolean, getIdentifier().getName().data());
 		return nullptr;
 	}
@@ -183,6 +259,10 @@ public:
 	{
 		return m_type && dynamic_cast<PointerType*>(m_type) != nullptr;
 	}
+	bool isArray()
+	{
+		return m_type && dynamic_cast<ArrayType*>(m_type) != nullptr;
+	}
 	virtual ~Variable() 
 	{
 		delete m_value;
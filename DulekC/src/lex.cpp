@@ -2,6 +2,10 @@
 #include "ContextAnalyzer.h"
 #include "parser.hpp" 
 #include "MessageEngine.h"
+#include "Generics.h"
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <memory>
 int __cdecl yylex();
 LexerContext* s_lc = nullptr;
@@ -56,6 +60,8 @@ static CMContext findNextContext(int token)
 		return CMContext::ELSE;
 	else if (token == WHILE_KEYWORD)
 		return CMContext::WHILE;
+	else if (token == FOR_KEYWORD)
+		return CMContext::FOR;
 	return CMContext::EMPTY;
 }
 
@@ -77,6 +83,118 @@ static void changeActualState(int token, CMContext context)
 	}
 }
 
+// `fnc name<` ... `>` hands the parser the rest of the declaration as one GENERIC_BODY token.
+static enum
+{
+	GENERIC_NONE = 0,
+	GENERIC_FUNCTION,
+	GENERIC_NAME,
+	GENERIC_PARAMS,
+	GENERIC_BODY_NEXT,
+} s_genericState = GENERIC_NONE;
+static std::deque<GenericToken> s_replay;
+
+static void trackGenericHeader(int token)
+{
+	if (token == FUNCTION_KEYWORD)
+		s_genericState = GENERIC_FUNCTION;
+	else if (s_genericState == GENERIC_FUNCTION && token == IDENTIFIER)
+		s_genericState = GENERIC_NAME;
+	else if (s_genericState == GENERIC_NAME && token == LT)
+		s_genericState = GENERIC_PARAMS;
+	else if (s_genericState == GENERIC_PARAMS && token == GT)
+		s_genericState = GENERIC_BODY_NEXT;
+	else if (s_genericState != GENERIC_PARAMS)
+		s_genericState = GENERIC_NONE;
+}
+
+static GenericToken recordToken(int token)
+{
+	GenericToken recorded{ token };
+	switch (token)
+	{
+	case IDENTIFIER:
+	case FLOAT_NUMBER:
+	case STRING_LITERAL:
+		recorded.text = yylval.str;
+		free(yylval.str);
+		break;
+	case NUMBER:
+	case ARRAY:
+		recorded.num = yylval.num;
+		break;
+	case BOOL: case I8: case U8: case I16: case U16: case I32: case U32: case I64: case U64: case F32: case F64:
+		recorded.bytetype = yylval.bytetype;
+		break;
+	default:
+		break;
+	}
+	return recorded;
+}
+
+static int replayToken(const GenericToken& recorded)
+{
+	switch (recorded.id)
+	{
+	case IDENTIFIER:
+	case FLOAT_NUMBER:
+	case STRING_LITERAL:
+		yylval.str = strdup(recorded.text.c_str());
+		break;
+	case NUMBER:
+	case ARRAY:
+		yylval.num = recorded.num;
+		break;
+	case TYPE_NAME:
+		yylval.ptype = recorded.type;
+		break;
+	case BOOL: case I8: case U8: case I16: case U16: case I32: case U32: case I64: case U64: case F32: case F64:
+		yylval.bytetype = recorded.bytetype;
+		break;
+	default:
+		break;
+	}
+	return recorded.id;
+}
+
+// Records a generic declaration up to the brace closing its body. The tokens bypass the scope
+// tracking, since nothing of the template is compiled until an instance replays it.
+static int captureGenericBody()
+{
+	auto* tokens = new std::vector<GenericToken>();
+	int depth = 0;
+	do
+	{
+		int token = yylex();
+		if (!token)
+			Error(MessageEngine::Code::BRACE_COUNTER, "{");
+		if (token == LBUCKLE)
+			depth++;
+		else if (token == RBUCKLE && --depth < 0)
+			Error(MessageEngine::Code::BRACE_COUNTER, "}");
+		tokens->push_back(recordToken(token));
+	} while (depth || tokens->back().id != RBUCKLE);
+	yylval.ptokens = tokens;
+	return GENERIC_BODY;
+}
+
+// Pending generic instances are spliced in between global statements, after the function
+// that first called them has closed.
+static int nextToken()
+{
+	GenericFunctions& generics = GenericFunctions::instance();
+	if (s_replay.empty() && generics.hasPending() && s_lc->isInGlobalContext() && s_genericState == GENERIC_NONE)
+	{
+		for (GenericToken& recorded : generics.takePending())
+			s_replay.push_back(std::move(recorded));
+	}
+	if (s_replay.empty())
+		return yylex();
+	GenericToken recorded = std::move(s_replay.front());
+	s_replay.pop_front();
+	return replayToken(recorded);
+}
+
 void initlex(void)
 {
 	static bool isInited = false;
@@ -126,7 +244,12 @@ void summaryBracesCounter(int arr[IDX_END])
 
 int __cdecl lex(void)
 {
-	int token = yylex();
+	if (s_genericState == GENERIC_BODY_NEXT)
+	{
+		s_genericState = GENERIC_NONE;
+		return captureGenericBody();
+	}
+	int token = nextToken();
 	static int* braces = getBraces();
 	if (!token)
 	{
@@ -148,5 +271,6 @@ int __cdecl lex(void)
 	analyzeBraces(token, braces);
 	nextContext = findNextContext(token);
 	changeActualState(token, nextContext);
+	trackGenericHeader(token);
 	return token;
 }
\ No newline at end of file
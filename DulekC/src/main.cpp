@@ -16,6 +16,8 @@
 #include <memory>
 #include <Windows.h>
 #include "DuFunctions.h"
+#include "TargetEmitter.h"
+#include <string_view>
 int yyparse(void);
 extern FILE* yyin;
 #define NOT_IMPLEMENTED_FEATURE_
@@ -36,18 +38,103 @@ int main(int argc, char* argv[])
 {
 	initTerminalMessageEngine();
 	DuDisplay("\tCompilation Begin...\n");
-	errno_t code;
-	if(argc > 1)
-		code = fopen_s(&yyin, argv[1], "r");
-	else
-		code = fopen_s(&yyin, "Main.du", "r");
+	EmitMode emitMode = EmitMode::JIT;
+	unsigned jobs = 0;
+	CodeGenOptions options;
+	const char* input = "Main.du";
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (arg.starts_with("-emit="))
+		{
+			auto mode = TargetEmitter::parseEmitMode(arg.substr(sizeof("-emit=") - 1));
+			if (!mode)
+				Error(MessageEngine::Code::WRONG_ARGUMENT, arg);
+			emitMode = *mode;
+		}
+		else if (arg.starts_with("-j="))
+		{
+			jobs = static_cast<unsigned>(std::strtoul(argv[i] + sizeof("-j=") - 1, nullptr, 10));
+			if (!jobs)
+				Error(MessageEngine::Code::WRONG_ARGUMENT, arg);
+		}
+		else if (arg.starts_with("-split="))
+		{
+			options.splitParts = static_cast<unsigned>(std::strtoul(argv[i] + sizeof("-split=") - 1, nullptr, 10));
+			if (!options.splitParts)
+				Error(MessageEngine::Code::WRONG_ARGUMENT, arg);
+		}
+		else if (arg.starts_with("-march="))
+		{
+			options.cpu = arg.substr(sizeof("-march=") - 1);
+		}
+		else if (arg.starts_with("-cache="))
+		{
+			options.cacheDirectory = arg.substr(sizeof("-cache=") - 1);
+		}
+		else if (arg.starts_with("-cache-size="))
+		{
+			options.cacheSizeLimit = std::strtoull(argv[i] + sizeof("-cache-size=") - 1, nullptr, 10) * 1024 * 1024;
+		}
+		else if (arg == "-profile-generate")
+		{
+			options.profileGenerate = "default.duprof";
+		}
+		else if (arg.starts_with("-profile-generate="))
+		{
+			options.profileGenerate = arg.substr(sizeof("-profile-generate=") - 1);
+		}
+		else if (arg.starts_with("-profile-use="))
+		{
+			options.profileUse = arg.substr(sizeof("-profile-use=") - 1);
+		}
+		else if (arg == "-tiered")
+		{
+			options.tierThreshold = TieredJIT::s_defaultThreshold;
+		}
+		else if (arg.starts_with("-tiered="))
+		{
+			options.tierThreshold = std::strtoull(argv[i] + sizeof("-tiered=") - 1, nullptr, 10);
+			if (!options.tierThreshold)
+				Error(MessageEngine::Code::WRONG_ARGUMENT, arg);
+		}
+		else if (arg.starts_with("-linker="))
+		{
+			options.linker = arg.substr(sizeof("-linker=") - 1);
+		}
+		else if (arg == "-bounds-check")
+		{
+			BoundsCheck::enable();
+		}
+		else if (arg == "-fastmath")
+		{
+			Function::enableFastMath();
+		}
+		else if (arg.starts_with("-specialize-budget="))
+		{
+			CallSiteSpecialization::setBudget(std::strtoull(argv[i] + sizeof("-specialize-budget=") - 1, nullptr, 10));
+		}
+		else if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' && arg[2] <= '3')
+		{
+			options.optLevel = arg[2] - '0';
+		}
+		else
+			input = argv[i];
+	}
+	errno_t code = fopen_s(&yyin, input, "r");
 	if (code)
-		Error(MessageEngine::Code::CANNOT_OPEN_FILE, argc > 1 ? argv[1] : "Main.du");
+		Error(MessageEngine::Code::CANNOT_OPEN_FILE, input);
 	initlex();
 	yyparse();
 	LLVMGen generator("test");
-	generator.genIRForFile(AstTree::instance().begin(), AstTree::instance().end());
+	if (jobs)
+		generator.genIRForFileParallel(AstTree::instance().begin(), AstTree::instance().end(), jobs);
+	else
+		generator.genIRForFile(AstTree::instance().begin(), AstTree::instance().end());
 	//generator.print();
-	generator.executeCodeToByteCode();
+	if (emitMode == EmitMode::JIT)
+		generator.executeCodeToByteCode(options);
+	else if (!generator.emit(emitMode, "output", options))
+		return 1;
 	return 0;
 }